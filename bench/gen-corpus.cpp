@@ -0,0 +1,239 @@
+#include <bits/stdc++.h>
+
+using namespace std;
+
+// Writes UTF-8 to a file or stdout in large blocks, and stops accepting
+// characters once the byte budget is reached.
+class utf8_sink {
+public:
+    utf8_sink(FILE *out, uint64_t limit) : m_out(out), m_limit(limit) {}
+    ~utf8_sink() {
+        flush();
+    }
+
+    bool full() const {
+        return m_written + m_buf.size() >= m_limit;
+    }
+    void put(char32_t c) {
+        char bytes[4];
+        int n = encode(c, bytes);
+        if(m_written + m_buf.size() + n > m_limit) {
+            m_limit = m_written + m_buf.size();
+            return;
+        }
+        m_buf.append(bytes, n);
+        if(m_buf.size() >= 1 << 20) flush();
+    }
+    void put(const u32string &s) {
+        for(char32_t c : s) {
+            if(full()) return;
+            put(c);
+        }
+    }
+    void flush() {
+        fwrite(m_buf.data(), 1, m_buf.size(), m_out);
+        m_written += m_buf.size();
+        m_buf.clear();
+    }
+
+private:
+    static int encode(char32_t c, char *out) {
+        if(c < 0x80) {
+            out[0] = c;
+            return 1;
+        }
+        if(c < 0x800) {
+            out[0] = 0xC0 | c >> 6;
+            out[1] = 0x80 | (c & 0x3F);
+            return 2;
+        }
+        out[0] = 0xE0 | c >> 12;
+        out[1] = 0x80 | (c >> 6 & 0x3F);
+        out[2] = 0x80 | (c & 0x3F);
+        return 3;
+    }
+
+    FILE *m_out;
+    uint64_t m_limit, m_written = 0;
+    string m_buf;
+};
+
+struct options {
+    string kind = "zipf", out;
+    uint64_t size = 64 << 20;
+    int alphabet = 26;
+    int vocabulary = 50000;
+    double zipf_s = 1.1;
+    int period = 1000;
+    uint64_t base = 1 << 20;
+    double edit_rate = 0.001;
+    uint64_t seed = 1;
+};
+
+// Lowercase latin first, then CJK ideographs, so small alphabets stay ASCII
+// and large ones look like the Chinese examples.
+char32_t symbol(int k) {
+    return k < 26 ? U'a' + k : U'一' + (k - 26);
+}
+
+class zipf_words {
+public:
+    zipf_words(const options &opt, mt19937_64 &rng) : m_rng(rng) {
+        // Words are 1 to 8 symbols long, which bounds the distinct ones a
+        // small alphabet allows.
+        long long distinct = 0, power = 1;
+        for(int len = 1; len <= 8; ++len) {
+            power = min<long long>(power * opt.alphabet, INT_MAX);
+            distinct = min<long long>(distinct + power, INT_MAX);
+        }
+        int vocabulary = opt.vocabulary;
+        if(distinct < vocabulary) {
+            cerr << "warning: an alphabet of " << opt.alphabet << " allows only " << distinct << " distinct words; vocabulary clamped" << endl;
+            vocabulary = distinct;
+        }
+        if(2 * (long long)vocabulary >= distinct) {
+            // Sampling would spend most of its time on repeats; list every
+            // word and keep a random subset instead.
+            vector<int> digits;
+            while(m_words.size() < distinct) {
+                int k = digits.size() - 1;
+                while(k >= 0 && digits[k] == opt.alphabet - 1) digits[k--] = 0;
+                if(k >= 0) ++digits[k];
+                else digits.insert(digits.begin(), 0);
+                u32string w;
+                for(int d : digits) w += symbol(d);
+                m_words.push_back(w);
+            }
+            shuffle(m_words.begin(), m_words.end(), rng);
+            m_words.resize(vocabulary);
+        } else {
+            set<u32string> seen;
+            while(m_words.size() < vocabulary) {
+                u32string w;
+                for(int len = 1 + rng() % 8; len > 0; --len) w += symbol(rng() % opt.alphabet);
+                if(seen.insert(w).second) m_words.push_back(w);
+            }
+        }
+        double total = 0;
+        for(int r = 1; r <= vocabulary; ++r) {
+            total += pow(r, -opt.zipf_s);
+            m_cdf.push_back(total);
+        }
+    }
+    // Words separated by spaces, with a line break every dozen or so.
+    u32string sentence() {
+        u32string s;
+        for(int k = 4 + m_rng() % 16; k > 0; --k) {
+            double x = uniform_real_distribution<double>(0, m_cdf.back())(m_rng);
+            s += m_words[lower_bound(m_cdf.begin(), m_cdf.end(), x) - m_cdf.begin()];
+            s += k > 1 ? U' ' : U'\n';
+        }
+        return s;
+    }
+
+private:
+    mt19937_64 &m_rng;
+    vector<u32string> m_words;
+    vector<double> m_cdf;
+};
+
+// Substitutions, insertions and deletions at edit_rate per character.
+u32string mutate(const u32string &s, const options &opt, mt19937_64 &rng) {
+    u32string ans;
+    ans.reserve(s.size() + s.size() / 64);
+    bernoulli_distribution edit(opt.edit_rate);
+    for(char32_t c : s) {
+        if(!edit(rng)) {
+            ans += c;
+            continue;
+        }
+        switch(rng() % 3) {
+        case 0:
+            ans += symbol(rng() % opt.alphabet);
+            break;
+        case 1:
+            ans += c;
+            ans += symbol(rng() % opt.alphabet);
+            break;
+        default:
+            break;
+        }
+    }
+    return ans;
+}
+
+void generate(const options &opt, utf8_sink &sink) {
+    mt19937_64 rng(opt.seed);
+    if(opt.kind == "random") {
+        while(!sink.full()) sink.put(symbol(rng() % opt.alphabet));
+    } else if(opt.kind == "zipf") {
+        zipf_words words(opt, rng);
+        while(!sink.full()) sink.put(words.sentence());
+    } else if(opt.kind == "repetitive") {
+        u32string unit;
+        for(int i = 0; i < opt.period; ++i) unit += symbol(rng() % opt.alphabet);
+        while(!sink.full()) sink.put(mutate(unit, opt, rng));
+    } else if(opt.kind == "versions") {
+        zipf_words words(opt, rng);
+        u32string doc;
+        while(doc.size() < opt.base) doc += words.sentence();
+        while(!sink.full()) {
+            sink.put(doc);
+            doc = mutate(doc, opt, rng);
+        }
+    } else {
+        throw invalid_argument("unknown kind " + opt.kind);
+    }
+}
+
+uint64_t parse_size(const string &s) {
+    size_t used;
+    double x = stod(s, &used);
+    string unit = s.substr(used);
+    if(unit == "K" || unit == "k") x *= 1 << 10;
+    else if(unit == "M" || unit == "m") x *= 1 << 20;
+    else if(unit == "G" || unit == "g") x *= 1 << 30;
+    else if(!unit.empty()) throw invalid_argument("bad size " + s);
+    return x;
+}
+
+int main(int argc, char *argv[]) {
+    options opt;
+    try {
+        for(int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            if(i + 1 >= argc) throw invalid_argument(arg);
+            string value = argv[++i];
+            if(arg == "--kind") opt.kind = value;
+            else if(arg == "--size") opt.size = parse_size(value);
+            else if(arg == "--alphabet") opt.alphabet = clamp(stoi(value), 1, 20000);
+            else if(arg == "--vocabulary") opt.vocabulary = max(1, stoi(value));
+            else if(arg == "--zipf") opt.zipf_s = stod(value);
+            else if(arg == "--period") opt.period = max(1, stoi(value));
+            else if(arg == "--base") opt.base = max<uint64_t>(1, parse_size(value));
+            else if(arg == "--edit-rate") opt.edit_rate = stod(value);
+            else if(arg == "--seed") opt.seed = stoull(value);
+            else if(arg == "--out") opt.out = value;
+            else throw invalid_argument(arg);
+        }
+    } catch(const exception &e) {
+        cerr << "bad argument " << e.what() << "\n"
+             << "usage: " << argv[0] << " [--kind random|zipf|repetitive|versions] [--size N[K|M|G]] [--alphabet N]\n"
+             << "       [--vocabulary N] [--zipf S] [--period N] [--base N[K|M|G]] [--edit-rate P] [--seed N] [--out file]" << endl;
+        return 2;
+    }
+    FILE *out = opt.out.empty() ? stdout : fopen(opt.out.c_str(), "wb");
+    if(!out) {
+        cerr << "cannot open " << opt.out << endl;
+        return 2;
+    }
+    try {
+        utf8_sink sink(out, opt.size);
+        generate(opt, sink);
+    } catch(const exception &e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+    if(out != stdout) fclose(out);
+    return 0;
+}
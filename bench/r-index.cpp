@@ -0,0 +1,56 @@
+#include "string-data.hpp"
+#include "r-index.hpp"
+#include <bits/stdc++.h>
+
+using namespace std;
+using namespace sa_ps;
+
+wstring load(const char *path) {
+    wifstream file(path);
+    if(!file) throw runtime_error(string("cannot open ") + path);
+    file.imbue(locale("C.UTF-8"));
+    return wstring((istreambuf_iterator<wchar_t>(file)), istreambuf_iterator<wchar_t>());
+}
+
+template<class F>
+double time_ms(F &&f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+// Size and query speed of r_index against string_data on each corpus given,
+// e.g. ones written by gen-corpus --kind versions.
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        cerr << "usage: " << argv[0] << " corpus..." << endl;
+        return 2;
+    }
+    cout << left << setw(28) << "corpus" << setw(11) << "chars" << setw(10) << "runs" << setw(8) << "n/r" << setw(14) << "text+SA(MB)"
+         << setw(12) << "r-index(MB)" << setw(22) << "count(us) sd / ri" << "locate(us) sd / ri" << endl;
+    for(int f = 1; f < argc; ++f) {
+        auto text = load(argv[f]);
+        unique_ptr<string_data> plain;
+        unique_ptr<r_index> runs;
+        double build_plain = time_ms([&] { plain = make_unique<string_data>(text); });
+        double build_runs = time_ms([&] { runs = make_unique<r_index>(text); });
+        mt19937 rng(7);
+        vector<wstring> patterns;
+        for(int i = 0; i < 2000; ++i) {
+            patterns.push_back(text.substr(rng() % (text.size() - 8), 3 + rng() % 6));
+        }
+        size_t sink = 0;
+        double count_plain = time_ms([&] { for(auto &p : patterns) sink += plain->count(p); }) * 1000 / patterns.size();
+        double count_runs = time_ms([&] { for(auto &p : patterns) sink += runs->count(p); }) * 1000 / patterns.size();
+        double locate_plain = time_ms([&] { for(auto &p : patterns) sink += plain->search(p).size(); }) * 1000 / patterns.size();
+        double locate_runs = time_ms([&] { for(auto &p : patterns) sink += runs->search(p).size(); }) * 1000 / patterns.size();
+        double plain_mb = (text.size() * sizeof(wchar_t) + plain->sa_bytes()) / 1e6;
+        string name = filesystem::path(argv[f]).filename().string();
+        cout << setw(28) << name.substr(0, 27) << setw(11) << text.size() << setw(10) << runs->runs() << setw(8) << fixed << setprecision(1)
+             << (double)text.size() / runs->runs() << setw(14) << plain_mb << setw(12) << runs->bytes() / 1e6 << setprecision(2)
+             << setw(22) << (to_string(count_plain).substr(0, 6) + " / " + to_string(count_runs).substr(0, 6))
+             << to_string(locate_plain).substr(0, 7) << " / " << to_string(locate_runs).substr(0, 7) << defaultfloat << endl;
+        cout << "  build ms: string_data " << build_plain << ", r_index " << build_runs << (sink == size_t(-1) ? " " : "") << endl;
+    }
+    return 0;
+}
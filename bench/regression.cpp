@@ -0,0 +1,164 @@
+#include "string-data.hpp"
+#include <bits/stdc++.h>
+
+using namespace std;
+using namespace sa_ps;
+
+#ifndef SA_PS_SOURCE_DIR
+#define SA_PS_SOURCE_DIR ".."
+#endif
+// Timings only compare on the machine that produced them, so the baseline is
+// generated locally (--update) and never checked in.
+#ifndef SA_PS_BASELINE
+#define SA_PS_BASELINE "bench-baseline.json"
+#endif
+
+// Every metric the runner reports; the direction decides which way a change
+// counts as a regression.
+struct metric {
+    string name;
+    bool higher_is_better;
+    double value;
+};
+
+wstring load(const string &path, size_t &bytes) {
+    wifstream file(path);
+    if(!file) throw runtime_error("cannot open " + path);
+    file.imbue(locale("C.UTF-8"));
+    wstring text((istreambuf_iterator<wchar_t>(file)), istreambuf_iterator<wchar_t>());
+    ifstream raw(path, ios::binary | ios::ate);
+    bytes = raw.tellg();
+    return text;
+}
+
+double seconds_since(chrono::steady_clock::time_point t0) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+double percentile(vector<double> v, double p) {
+    size_t k = min(v.size() - 1, (size_t)(p * v.size()));
+    nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+vector<metric> run(const wstring &text, size_t bytes) {
+    vector<metric> metrics;
+    double best = 1e30;
+    for(int rep = 0; rep < 3; ++rep) {
+        auto t0 = chrono::steady_clock::now();
+        auto sa = detail::suffix_array(text);
+        best = min(best, seconds_since(t0));
+        if(sa.size() != text.size()) throw logic_error("bad suffix array");
+    }
+    metrics.push_back({"sa_is_mb_per_s", true, bytes / 1e6 / best});
+
+    string_data data(text);
+    mt19937 rng(2024);
+    auto sample = [&](int len) {
+        return text.substr(rng() % (text.size() - len), len);
+    };
+    vector<double> latency;
+    size_t sink = 0;
+    for(int i = 0; i < 20000; ++i) {
+        auto pattern = sample(2 + rng() % 5);
+        auto t0 = chrono::steady_clock::now();
+        sink += data.search(pattern).size();
+        latency.push_back(seconds_since(t0) * 1e6);
+    }
+    metrics.push_back({"search_p50_us", false, percentile(latency, 0.50)});
+    metrics.push_back({"search_p90_us", false, percentile(latency, 0.90)});
+    metrics.push_back({"search_p99_us", false, percentile(latency, 0.99)});
+
+    constexpr int queries = 500;
+    vector<detail::grouped_data<detail::group_type::AND>> ands(queries);
+    vector<detail::grouped_data<detail::group_type::OR>> ors(queries);
+    for(int i = 0; i < queries; ++i) {
+        for(int k = 2 + rng() % 2; k > 0; --k) ands[i].strs.push_back(sample(1 + rng() % 3));
+        for(int k = 2 + rng() % 4; k > 0; --k) ors[i].strs.push_back(sample(2 + rng() % 3));
+    }
+    auto t0 = chrono::steady_clock::now();
+    for(auto &q : ands) sink += data.search(q, 10).size();
+    metrics.push_back({"grouped_and_qps", true, queries / seconds_since(t0)});
+    t0 = chrono::steady_clock::now();
+    for(auto &q : ors) sink += data.search(q, 0).size();
+    metrics.push_back({"grouped_or_qps", true, queries / seconds_since(t0)});
+    if(sink == size_t(-1)) cout << "";
+    return metrics;
+}
+
+string to_json(const vector<metric> &metrics, double tolerance) {
+    ostringstream out;
+    out << "{\n  \"tolerance\": " << tolerance << ",\n  \"metrics\": {\n";
+    for(size_t i = 0; i < metrics.size(); ++i) {
+        out << "    \"" << metrics[i].name << "\": " << fixed << setprecision(3) << metrics[i].value << (i + 1 < metrics.size() ? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+    return out.str();
+}
+
+// Reads back the flat "name": number pairs that to_json writes.
+map<string, double> parse_json(const string &path) {
+    ifstream file(path);
+    if(!file) throw runtime_error("cannot open " + path);
+    string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    map<string, double> values;
+    regex pair("\"([A-Za-z0-9_]+)\"\\s*:\\s*(-?[0-9.eE+-]+)");
+    for(sregex_iterator it(text.begin(), text.end(), pair), end; it != end; ++it) {
+        values[(*it)[1]] = stod((*it)[2]);
+    }
+    return values;
+}
+
+int main(int argc, char *argv[]) {
+    string corpus = SA_PS_SOURCE_DIR "/examples/hlm.txt";
+    string baseline = SA_PS_BASELINE;
+    string out;
+    double tolerance = -1;
+    bool update = false;
+    for(int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if(arg == "--corpus" && i + 1 < argc) corpus = argv[++i];
+        else if(arg == "--baseline" && i + 1 < argc) baseline = argv[++i];
+        else if(arg == "--out" && i + 1 < argc) out = argv[++i];
+        else if(arg == "--tolerance" && i + 1 < argc) tolerance = stod(argv[++i]);
+        else if(arg == "--update") update = true;
+        else {
+            cerr << "usage: " << argv[0] << " [--corpus file] [--baseline file] [--out file] [--tolerance fraction] [--update]" << endl;
+            return 2;
+        }
+    }
+    try {
+        size_t bytes;
+        auto text = load(corpus, bytes);
+        auto metrics = run(text, bytes);
+        if(update) {
+            ofstream(baseline) << to_json(metrics, tolerance < 0 ? 0.25 : tolerance);
+            cout << "baseline written to " << baseline << endl;
+            return 0;
+        }
+        if(!ifstream(baseline)) {
+            cerr << "no baseline at " << baseline << "; record one on this machine with " << argv[0] << " --update" << endl;
+            return 2;
+        }
+        auto base = parse_json(baseline);
+        if(tolerance < 0) tolerance = base.count("tolerance") ? base["tolerance"] : 0.25;
+        if(!out.empty()) ofstream(out) << to_json(metrics, tolerance);
+        bool regressed = false;
+        cout << left << setw(18) << "metric" << setw(14) << "baseline" << setw(14) << "current" << "change" << endl;
+        for(auto &m : metrics) {
+            cout << setw(18) << m.name;
+            if(!base.count(m.name)) {
+                cout << setw(14) << "-" << setw(14) << m.value << "new" << endl;
+                continue;
+            }
+            double b = base[m.name], change = m.value / b - 1;
+            bool bad = m.higher_is_better ? change < -tolerance : change > tolerance;
+            regressed |= bad;
+            cout << setw(14) << b << setw(14) << m.value << showpos << fixed << setprecision(1) << change * 100 << "%" << noshowpos << defaultfloat << setprecision(6) << (bad ? "  REGRESSION" : "") << endl;
+        }
+        return regressed ? 1 : 0;
+    } catch(const exception &e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+}
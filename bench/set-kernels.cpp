@@ -0,0 +1,69 @@
+#include "set-kernels.hpp"
+#include <bits/stdc++.h>
+
+using namespace std;
+using namespace sa_ps::detail;
+
+// The per-element loop grouped_match used before the kernels, for reference.
+vector<int> branchy_merge(span<const int> a, span<const int> b, int md, bool uni) {
+    vector<int> ans;
+    size_t j = 0, k = 0;
+    while(j < a.size() && k < b.size()) {
+        if(abs(a[j] - b[k]) <= md) {
+            ans.push_back(min(a[j], b[k]));
+            ++j;
+            ++k;
+        } else if(a[j] < b[k]) {
+            if(uni) ans.push_back(a[j]);
+            ++j;
+        } else {
+            if(uni) ans.push_back(b[k]);
+            ++k;
+        }
+    }
+    if(uni) {
+        ans.insert(ans.end(), a.begin() + j, a.end());
+        ans.insert(ans.end(), b.begin() + k, b.end());
+    }
+    return ans;
+}
+
+vector<int> random_sorted(mt19937 &rng, int size, int universe) {
+    vector<int> v(size);
+    for(auto &x : v) x = rng() % universe;
+    sort(v.begin(), v.end());
+    v.erase(unique(v.begin(), v.end()), v.end());
+    return v;
+}
+
+template<class F>
+double time_us(F &&f, int reps) {
+    size_t sink = 0;
+    auto t0 = chrono::high_resolution_clock::now();
+    for(int i = 0; i < reps; ++i) sink += f().size();
+    auto t1 = chrono::high_resolution_clock::now();
+    if(sink == size_t(-1)) cout << "";
+    return chrono::duration<double, micro>(t1 - t0).count() / reps;
+}
+
+int main(int argc, char *argv[]) {
+    int big = argc > 1 ? atoi(argv[1]) : 1 << 20;
+    int md = argc > 2 ? atoi(argv[2]) : 5;
+    mt19937 rng(42);
+    cout << "intersection: " << (ssse3_intersect() ? "SSSE3 shuffle kernel" : "scalar fallback") << endl;
+    cout << left << setw(8) << "ratio" << setw(10) << "kernel" << setw(14) << "branchy(us)" << setw(14) << "scalar(us)" << setw(14) << "dispatch(us)" << "speedup" << endl;
+    for(int ratio : {1, 4, 16, 64, 256, 1024}) {
+        auto a = random_sorted(rng, big / ratio, big * 4);
+        auto b = random_sorted(rng, big, big * 4);
+        int reps = max(5, 64 / ratio);
+        auto row = [&](const char *name, auto &&branchy_fn, auto &&scalar_fn, auto &&fast_fn) {
+            double r = time_us(branchy_fn, reps), s = time_us(scalar_fn, reps), f = time_us(fast_fn, reps);
+            cout << left << setw(8) << ("1:" + to_string(ratio)) << setw(10) << name << fixed << setprecision(1) << setw(14) << r << setw(14) << s << setw(14) << f << setprecision(2) << r / f << "x" << endl;
+        };
+        row("and", [&] { return branchy_merge(a, b, 0, false); }, [&] { return scalar::sorted_intersect(a, b); }, [&] { return sorted_intersect(a, b); });
+        row("or", [&] { return branchy_merge(a, b, 0, true); }, [&] { return scalar::sorted_union(a, b); }, [&] { return sorted_union(a, b); });
+        row("and/md", [&] { return branchy_merge(a, b, md, false); }, [&] { return scalar::window_and(a, b, md); }, [&] { return window_and(a, b, md); });
+        row("or/md", [&] { return branchy_merge(a, b, md, true); }, [&] { return scalar::window_or(a, b, md); }, [&] { return window_or(a, b, md); });
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <thread>
+
+namespace sa_ps {
+
+namespace detail {
+
+// Aho-Corasick automaton over wchar_t. Children of every node are stored
+// sorted in one flat array, and transitions follow failure links on demand
+// instead of materialising a full DFA over the 65536-letter alphabet; only
+// the root, where most failure chains end, gets a direct table.
+class aho_corasick {
+public:
+    explicit aho_corasick(const std::vector<std::wstring> &patterns) : m_patterns(patterns.size()), m_max_len(0) {
+        std::vector<std::vector<std::pair<wchar_t, int>>> children(1);
+        m_nodes.push_back({});
+        for(int id = 0; id < patterns.size(); ++id) {
+            auto &p = patterns[id];
+            m_max_len = std::max<int>(m_max_len, p.size());
+            int v = 0;
+            for(wchar_t c : p) {
+                auto it = std::find_if(children[v].begin(), children[v].end(), [&](auto &e) { return e.first == c; });
+                if(it != children[v].end()) {
+                    v = it->second;
+                    continue;
+                }
+                children[v].push_back({c, (int)m_nodes.size()});
+                v = m_nodes.size();
+                m_nodes.push_back({});
+                children.emplace_back();
+            }
+            m_nodes[v].terms.push_back(id);
+        }
+        for(int v = 0; v < m_nodes.size(); ++v) {
+            std::sort(children[v].begin(), children[v].end());
+            m_nodes[v].first = m_edges.size();
+            m_edges.insert(m_edges.end(), children[v].begin(), children[v].end());
+            m_nodes[v].last = m_edges.size();
+        }
+        m_root.assign(65536, 0);
+        std::queue<int> bfs;
+        for(int e = m_nodes[0].first; e < m_nodes[0].last; ++e) {
+            int u = m_edges[e].second;
+            if((unsigned)m_edges[e].first < m_root.size()) m_root[m_edges[e].first] = u;
+            m_nodes[u].depth = 1;
+            bfs.push(u);
+        }
+        while(!bfs.empty()) {
+            int v = bfs.front();
+            bfs.pop();
+            for(int e = m_nodes[v].first; e < m_nodes[v].last; ++e) {
+                auto [c, u] = m_edges[e];
+                m_nodes[u].depth = m_nodes[v].depth + 1;
+                m_nodes[u].fail = next(m_nodes[v].fail, c);
+                int f = m_nodes[u].fail;
+                m_nodes[u].output = m_nodes[f].terms.empty() ? m_nodes[f].output : f;
+                bfs.push(u);
+            }
+        }
+    }
+
+    int patterns() const {
+        return m_patterns;
+    }
+    int max_length() const {
+        return m_max_len;
+    }
+
+    // Calls f(start, term) for every occurrence starting in [begin, end), in
+    // order of end position. Scanning starts max_length() - 1 characters
+    // early so that chunks scanned separately miss nothing.
+    template<class F>
+    void scan(std::wstring_view s, int begin, int end, F &&f) const {
+        int v = 0;
+        int from = std::max(0, begin - std::max(0, m_max_len - 1));
+        int to = std::min<long long>(s.size(), (long long)end + m_max_len - 1);
+        for(int i = from; i < to; ++i) {
+            v = next(v, s[i]);
+            for(int u = m_nodes[v].terms.empty() ? m_nodes[v].output : v; u > 0; u = m_nodes[u].output) {
+                int start = i + 1 - m_nodes[u].depth;
+                if(start < begin || start >= end) continue;
+                for(int id : m_nodes[u].terms) f(start, id);
+            }
+        }
+    }
+
+private:
+    struct node {
+        int first = 0, last = 0;
+        int fail = 0, output = 0, depth = 0;
+        std::vector<int> terms;
+    };
+
+    int child(int v, wchar_t c) const {
+        auto first = m_edges.begin() + m_nodes[v].first, last = m_edges.begin() + m_nodes[v].last;
+        auto it = std::lower_bound(first, last, c, [](const std::pair<wchar_t, int> &e, wchar_t x) {
+            return e.first < x;
+        });
+        return it != last && it->first == c ? it->second : -1;
+    }
+    int next(int v, wchar_t c) const {
+        while(v != 0) {
+            int u = child(v, c);
+            if(u != -1) return u;
+            v = m_nodes[v].fail;
+        }
+        if((unsigned)c < m_root.size()) return m_root[c];
+        int u = child(0, c);
+        return u == -1 ? 0 : u;
+    }
+
+    int m_patterns, m_max_len;
+    std::vector<node> m_nodes;
+    std::vector<std::pair<wchar_t, int>> m_edges;
+    std::vector<int> m_root;
+};
+
+// Per-pattern sorted hit lists from one automaton pass per chunk of the text.
+// Occurrences of one pattern are reported in start order, and chunks cover
+// increasing start ranges, so appending keeps every list sorted.
+std::vector<std::vector<int>> scan_lists(std::wstring_view s, const std::vector<std::wstring> &patterns, unsigned threads) {
+    std::vector<std::vector<int>> lists(patterns.size());
+    std::vector<std::wstring> nonempty;
+    std::vector<int> ids;
+    for(int i = 0; i < patterns.size(); ++i) {
+        if(patterns[i].empty()) {
+            lists[i].resize(s.size());
+            std::iota(lists[i].begin(), lists[i].end(), 0);
+        } else {
+            nonempty.push_back(patterns[i]);
+            ids.push_back(i);
+        }
+    }
+    if(nonempty.empty()) return lists;
+    aho_corasick ac(nonempty);
+    int n = s.size();
+    threads = std::max(1u, std::min<unsigned>(threads, n / 65536 + 1));
+    std::vector<std::vector<std::vector<int>>> chunks(threads - 1, std::vector<std::vector<int>>(patterns.size()));
+    auto work = [&](unsigned id) {
+        auto &out = id ? chunks[id - 1] : lists;
+        ac.scan(s, (long long)n * id / threads, (long long)n * (id + 1) / threads, [&](int start, int term) {
+            out[ids[term]].push_back(start);
+        });
+    };
+    std::vector<std::thread> workers;
+    for(unsigned id = 1; id < threads; ++id) {
+        workers.emplace_back(work, id);
+    }
+    work(0);
+    for(auto &worker : workers) worker.join();
+    for(auto &chunk : chunks) {
+        for(int i = 0; i < patterns.size(); ++i) {
+            lists[i].insert(lists[i].end(), chunk[i].begin(), chunk[i].end());
+        }
+    }
+    return lists;
+}
+
+} // namespace detail
+
+} // namespace sa_ps
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "string-data.hpp"
+#include <vector>
+#include <deque>
+#include <variant>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <exception>
+
+namespace sa_ps {
+
+namespace detail {
+
+// Fixed set of workers, each owning a deque of tasks. A worker pops its own
+// newest task and, when out of work, steals the oldest task of another, so
+// subtasks spawned by a big query spread over idle workers while each worker
+// keeps the cache-warm end of its own deque.
+class work_stealing_pool {
+public:
+    explicit work_stealing_pool(unsigned threads) {
+        threads = std::max(1u, threads);
+        for(unsigned i = 0; i < threads; ++i) {
+            m_queues.push_back(std::make_unique<queue>());
+        }
+        for(unsigned i = 0; i < threads; ++i) {
+            m_workers.emplace_back([this, i](std::stop_token token) { work(i, token); });
+        }
+    }
+    ~work_stealing_pool() {
+        for(auto &worker : m_workers) worker.request_stop();
+        {
+            std::lock_guard lock(m_sleep);
+        }
+        m_wake.notify_all();
+    }
+
+    // From a worker the task goes to that worker's deque, otherwise the
+    // deques are filled round-robin.
+    void spawn(std::function<void()> task) {
+        ++m_pending;
+        auto [pool, index] = current();
+        unsigned target = pool == this ? index : m_next++ % m_queues.size();
+        {
+            std::lock_guard lock(m_queues[target]->mutex);
+            m_queues[target]->tasks.push_back(std::move(task));
+        }
+        ++m_queued;
+        {
+            std::lock_guard lock(m_sleep);
+        }
+        m_wake.notify_one();
+    }
+    // Blocks until every spawned task, including ones spawned by tasks, has
+    // finished; rethrows the first exception a task threw.
+    void wait() {
+        std::unique_lock lock(m_sleep);
+        m_done.wait(lock, [&] { return m_pending.load() == 0; });
+        if(auto error = std::exchange(m_error, nullptr)) std::rethrow_exception(error);
+    }
+    unsigned size() const {
+        return m_queues.size();
+    }
+
+private:
+    struct queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    static std::pair<const work_stealing_pool *, unsigned> &current() {
+        thread_local std::pair<const work_stealing_pool *, unsigned> worker = {nullptr, 0};
+        return worker;
+    }
+
+    bool take(unsigned self, std::function<void()> &task) {
+        for(unsigned k = 0; k < m_queues.size(); ++k) {
+            auto &q = *m_queues[(self + k) % m_queues.size()];
+            std::lock_guard lock(q.mutex);
+            if(q.tasks.empty()) continue;
+            if(k == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            } else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            --m_queued;
+            return true;
+        }
+        return false;
+    }
+    void work(unsigned self, std::stop_token token) {
+        current() = {this, self};
+        std::function<void()> task;
+        while(!token.stop_requested()) {
+            if(!take(self, task)) {
+                std::unique_lock lock(m_sleep);
+                m_wake.wait(lock, [&] { return token.stop_requested() || m_queued.load() > 0; });
+                continue;
+            }
+            try {
+                task();
+            } catch(...) {
+                std::lock_guard lock(m_sleep);
+                if(!m_error) m_error = std::current_exception();
+            }
+            task = nullptr;
+            if(--m_pending == 0) {
+                std::lock_guard lock(m_sleep);
+                m_done.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<queue>> m_queues;
+    std::atomic<long long> m_pending = 0, m_queued = 0;
+    std::atomic<unsigned> m_next = 0;
+    std::mutex m_sleep;
+    std::condition_variable m_wake, m_done;
+    std::exception_ptr m_error;
+    std::vector<std::jthread> m_workers;
+};
+
+} // namespace detail
+
+// Runs batches of mixed queries against one string_data on a work-stealing
+// pool. Single patterns are one task each. A grouped query spawns one task
+// per term lookup; the last lookup to finish spawns the merge, and an AND
+// merge with many hits is itself split into position ranges (see
+// cooccurrence_range), so one heavy query can occupy every worker.
+class batch_executor {
+public:
+    using query = std::variant<std::wstring, detail::grouped_data<detail::group_type::AND>, detail::grouped_data<detail::group_type::OR>>;
+
+    explicit batch_executor(const string_data &data, unsigned threads = std::thread::hardware_concurrency()) : m_data(data), m_pool(threads) {}
+
+    // Results in query order, each equal to what m_data.search would return.
+    std::vector<std::vector<int>> run(const std::vector<query> &queries, int max_distance = 5) {
+        std::vector<std::vector<int>> results(queries.size());
+        std::vector<std::unique_ptr<grouped_state>> states;
+        for(int i = 0; i < queries.size(); ++i) {
+            std::visit([&](auto &q) { schedule(q, max_distance, results[i], states); }, queries[i]);
+        }
+        m_pool.wait();
+        return results;
+    }
+
+private:
+    struct grouped_state {
+        grouped_state(bool is_and, int terms, int md, std::vector<int> &result)
+            : is_and(is_and), md(md), lists(terms), remaining(terms), result(result) {}
+        bool is_and;
+        int md;
+        std::vector<std::vector<int>> lists;
+        std::atomic<int> remaining;
+        std::vector<int> &result;
+        std::vector<std::vector<detail::match_window>> parts;
+    };
+
+    void schedule(const std::wstring &pattern, int, std::vector<int> &result, std::vector<std::unique_ptr<grouped_state>> &) {
+        m_pool.spawn([this, &pattern, &result] { result = m_data.search(pattern); });
+    }
+    // OR queries long enough for search() to consider a text scan keep its
+    // cost model and run as one task.
+    template<detail::group_type Type>
+    void schedule(const detail::grouped_data<Type> &data, int md, std::vector<int> &result, std::vector<std::unique_ptr<grouped_state>> &states) {
+        constexpr bool is_and = Type == detail::group_type::AND;
+        if(data.strs.empty() || (!is_and && data.strs.size() >= detail::scan_min_terms)) {
+            m_pool.spawn([this, &data, md, &result] { result = m_data.search(data, md); });
+            return;
+        }
+        states.push_back(std::make_unique<grouped_state>(is_and, data.strs.size(), md, result));
+        auto state = states.back().get();
+        for(int t = 0; t < data.strs.size(); ++t) {
+            m_pool.spawn([this, state, t, &term = data.strs[t]] {
+                state->lists[t] = m_data.search(term);
+                if(--state->remaining == 0) merge(state);
+            });
+        }
+    }
+
+    // Below this many hits an AND merge is not worth splitting.
+    static constexpr long long split_min_hits = 1 << 15;
+
+    void merge(grouped_state *state) {
+        if(!state->is_and) {
+            state->result = detail::or_merge(state->lists, state->md);
+            return;
+        }
+        long long hits = 0;
+        for(auto &list : state->lists) hits += list.size();
+        int n = hits < split_min_hits ? 1 : m_pool.size();
+        state->parts.resize(n);
+        state->remaining = n;
+        for(int p = 0; p < n; ++p) {
+            m_pool.spawn([this, state, p, n] {
+                std::vector<std::span<const int>> lists(state->lists.begin(), state->lists.end());
+                long long len = m_data.text().size();
+                state->parts[p] = detail::cooccurrence_range(lists, state->md, len * p / n, len * (p + 1) / n);
+                if(--state->remaining == 0) {
+                    for(auto &part : state->parts) {
+                        auto starts = detail::window_starts(part);
+                        state->result.insert(state->result.end(), starts.begin(), starts.end());
+                    }
+                }
+            });
+        }
+    }
+
+    const string_data &m_data;
+    detail::work_stealing_pool m_pool;
+};
+
+} // namespace sa_ps
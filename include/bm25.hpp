@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace sa_ps {
+
+struct bm25_params {
+    double k1 = 1.2;
+    double b = 0.75;
+};
+
+struct ranked_doc {
+    int id;
+    double score;
+};
+
+namespace detail {
+
+// One query term's documents in increasing ID order with the term's score in
+// each, and the largest of those scores.
+struct scored_postings {
+    std::vector<int> docs;
+    std::vector<double> scores;
+    double max_score = 0;
+};
+
+double bm25_idf(int docs, int df) {
+    return std::log(1 + (docs - df + 0.5) / (df + 0.5));
+}
+double bm25_score(double idf, int tf, double len, double avg_len, const bm25_params &params) {
+    return idf * tf * (params.k1 + 1) / (tf + params.k1 * (1 - params.b + params.b * len / avg_len));
+}
+
+// The k documents with the highest summed score, best first, ties to the
+// lower ID. WAND (Broder et al.): with the lists ordered by their current
+// document, the pivot is the first document whose lists' max scores together
+// could beat the k-th best so far; documents before it are skipped unscored.
+std::vector<ranked_doc> wand_top_k(const std::vector<scored_postings> &lists, int k) {
+    auto better = [](const ranked_doc &x, const ranked_doc &y) {
+        return x.score > y.score || (x.score == y.score && x.id < y.id);
+    };
+    std::vector<ranked_doc> heap;
+    if(k <= 0) return heap;
+    std::vector<std::size_t> pos(lists.size(), 0);
+    std::vector<int> order;
+    for(int i = 0; i < lists.size(); ++i) {
+        if(!lists[i].docs.empty()) order.push_back(i);
+    }
+    auto doc = [&](int i) {
+        return lists[i].docs[pos[i]];
+    };
+    while(!order.empty()) {
+        std::sort(order.begin(), order.end(), [&](int x, int y) {
+            return doc(x) < doc(y);
+        });
+        // Documents arrive in increasing ID order, so one that only ties the
+        // k-th best never displaces it.
+        double threshold = heap.size() < k ? -1 : heap.front().score;
+        double bound = 0;
+        int pivot = -1;
+        for(int j = 0; j < order.size(); ++j) {
+            bound += lists[order[j]].max_score;
+            if(bound > threshold) {
+                pivot = j;
+                break;
+            }
+        }
+        if(pivot == -1) break;
+        int target = doc(order[pivot]);
+        if(doc(order[0]) == target) {
+            double score = 0;
+            for(int j = 0; j < order.size() && doc(order[j]) == target; ++j) {
+                score += lists[order[j]].scores[pos[order[j]]++];
+            }
+            ranked_doc d = {target, score};
+            if(heap.size() < k) {
+                heap.push_back(d);
+                std::push_heap(heap.begin(), heap.end(), better);
+            } else if(better(d, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), better);
+                heap.back() = d;
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+        } else {
+            for(int j = 0; j < pivot; ++j) {
+                auto &docs = lists[order[j]].docs;
+                pos[order[j]] = std::lower_bound(docs.begin() + pos[order[j]], docs.end(), target) - docs.begin();
+            }
+        }
+        std::erase_if(order, [&](int i) {
+            return pos[i] == lists[i].docs.size();
+        });
+    }
+    std::sort_heap(heap.begin(), heap.end(), better);
+    return heap;
+}
+
+} // namespace detail
+
+} // namespace sa_ps
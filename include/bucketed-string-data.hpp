@@ -0,0 +1,106 @@
+#pragma once
+
+#include "sa-match.hpp"
+#include "grouped-data.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+namespace sa_ps {
+
+// Suffix array that is only bucketed by first character up front, in one
+// counting pass. A bucket is sorted the first time a query lands in it, and a
+// background thread sorts the rest, largest buckets first.
+class bucketed_string_data {
+public:
+    static constexpr int sigma = 65536;
+
+    explicit bucketed_string_data(const std::wstring &str, bool background = true)
+        : m_str(str), sa(str.size()), m_start(sigma + 1), m_once(std::make_unique<std::once_flag[]>(sigma)) {
+        detail::check_bmp(m_str);
+        for(wchar_t c : m_str) {
+            ++m_start[(unsigned)c + 1];
+        }
+        std::partial_sum(m_start.begin(), m_start.end(), m_start.begin());
+        std::vector<int> fill(m_start.begin(), m_start.end() - 1);
+        for(int i = 0; i < m_str.size(); ++i) {
+            sa[fill[(unsigned)m_str[i]]++] = i;
+        }
+        for(int c = 0; c < sigma; ++c) {
+            if(m_start[c + 1] - m_start[c] <= 1) std::call_once(m_once[c], [] {});
+        }
+        if(background) {
+            m_worker = std::jthread([this](std::stop_token token) { complete(token); });
+        }
+    }
+
+    // Blocks until every bucket is sorted; sa is then the full suffix array.
+    void wait() {
+        if(m_worker.joinable()) m_worker.join();
+        complete({});
+    }
+    int sorted_buckets() const {
+        return m_sorted.load();
+    }
+
+    std::vector<int> search(const std::wstring &pattern) const {
+        if(m_str.size() < pattern.size()) return {};
+        if(pattern.empty()) {
+            std::vector<int> ans(m_str.size());
+            std::iota(ans.begin(), ans.end(), 0);
+            return ans;
+        }
+        unsigned c = pattern[0];
+        if(c >= sigma) return {};
+        sort_bucket(c);
+        auto [l, r] = detail::sa_interval(m_str, sa, pattern, m_start[c], m_start[c + 1]);
+        std::vector<int> ans(sa.begin() + l, sa.begin() + r);
+        std::sort(ans.begin(), ans.end());
+        return ans;
+    }
+    template<detail::group_type Type>
+    std::vector<int> search(const detail::grouped_data<Type> &data, int max_distance = 5) const {
+        return detail::grouped_match_with(m_str.size(), data, max_distance, [&](const std::wstring &pattern) {
+            return search(pattern);
+        });
+    }
+
+private:
+    // Each bucket is sorted exactly once, by whichever thread touches it
+    // first; other threads wanting it wait on its once_flag.
+    void sort_bucket(unsigned c) const {
+        std::call_once(m_once[c], [&] {
+            std::wstring_view s(m_str);
+            std::sort(sa.begin() + m_start[c], sa.begin() + m_start[c + 1], [&](int a, int b) {
+                return s.substr(a + 1) < s.substr(b + 1);
+            });
+            ++m_sorted;
+        });
+    }
+    void complete(std::stop_token token) const {
+        std::vector<int> order(sigma);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return m_start[a + 1] - m_start[a] > m_start[b + 1] - m_start[b];
+        });
+        for(int c : order) {
+            if(token.stop_requested() || m_start[c + 1] - m_start[c] <= 1) break;
+            sort_bucket(c);
+        }
+    }
+
+    std::wstring m_str;
+    mutable std::vector<int> sa;
+    std::vector<int> m_start;
+    std::unique_ptr<std::once_flag[]> m_once;
+    mutable std::atomic<int> m_sorted = 0;
+    std::jthread m_worker;
+};
+
+} // namespace sa_ps
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "string-data.hpp"
+#include "bm25.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include <climits>
+
+namespace sa_ps {
+
+// Several documents behind one string_data, joined by a separator no pattern
+// may contain, so that no hit crosses a document boundary. Documents keep the
+// ID they were given at construction. remove() only sets a tombstone bit that
+// searches filter on; once the removed documents hold more than
+// compact_fraction of the indexed text, the index is rebuilt over the live ones.
+// A document array, the slot of each suffix in SA order, backs rank().
+class collection {
+public:
+    static constexpr wchar_t separator = L'\xFFFF';
+
+    explicit collection(const std::vector<std::wstring> &docs, double compact_fraction = 0.25)
+        : m_compact_fraction(compact_fraction), m_docs(docs.size()), m_removed((docs.size() + 63) / 64) {
+        std::wstring text;
+        for(int id = 0; id < docs.size(); ++id) {
+            m_slots.push_back(id);
+            m_start.push_back(text.size());
+            text += docs[id];
+            text += separator;
+        }
+        build(text);
+    }
+
+    // Marks a document deleted; returns false if it already was.
+    bool remove(int id) {
+        if(id < 0 || id >= m_docs || removed(id)) return false;
+        m_removed[id / 64] |= 1ull << (id % 64);
+        auto slot = std::lower_bound(m_slots.begin(), m_slots.end(), id) - m_slots.begin();
+        if(slot < m_slots.size() && m_slots[slot] == id) {
+            m_dead_chars += m_start[slot + 1] - m_start[slot];
+            ++m_dead_docs;
+        }
+        if(deleted_fraction() > m_compact_fraction) compact();
+        return true;
+    }
+    bool removed(int id) const {
+        return m_removed[id / 64] >> (id % 64) & 1;
+    }
+    // Share of the indexed text, separators included, owned by removed documents.
+    double deleted_fraction() const {
+        return m_start.back() ? (double)m_dead_chars / m_start.back() : 0;
+    }
+    // Rebuilds the index over the live documents only.
+    void compact() {
+        std::wstring_view text = m_index->text();
+        std::wstring live;
+        std::vector<int> slots, start;
+        for(int slot = 0; slot < m_slots.size(); ++slot) {
+            if(removed(m_slots[slot])) continue;
+            slots.push_back(m_slots[slot]);
+            start.push_back(live.size());
+            live += text.substr(m_start[slot], m_start[slot + 1] - m_start[slot]);
+        }
+        m_slots = std::move(slots);
+        m_start = std::move(start);
+        m_dead_chars = 0;
+        m_dead_docs = 0;
+        build(live);
+    }
+
+    // Document ID and offset in it of a position returned by search().
+    std::pair<int, int> locate(int pos) const {
+        int slot = std::upper_bound(m_start.begin(), m_start.end(), pos) - m_start.begin() - 1;
+        return {m_slots[slot], pos - m_start[slot]};
+    }
+
+    std::vector<int> search(const std::wstring &pattern) const {
+        if(pattern.find(separator) != std::wstring::npos) return {};
+        return live_hits(m_index->search(pattern));
+    }
+    // Each term's hits are restricted to live documents before the merge, and
+    // hits in different documents are never paired, so a live hit is not
+    // absorbed by one from a removed or neighbouring document.
+    std::vector<int> search(const detail::grouped_data<detail::group_type::OR> &data, int max_distance = 5) const {
+        for(auto &s : data.strs) {
+            if(s.find(separator) != std::wstring::npos) return {};
+        }
+        if(data.strs.empty()) return live_hits(m_index->search(data, max_distance));
+        std::vector<std::vector<int>> lists;
+        for(auto &s : data.strs) {
+            lists.push_back(live_hits(m_index->search(s)));
+        }
+        if(max_distance == 0) return detail::or_merge(lists, 0);
+        std::vector<int> ans;
+        std::vector<std::size_t> pos(lists.size());
+        std::vector<std::vector<int>> parts(lists.size());
+        while(true) {
+            int next = INT_MAX;
+            for(int i = 0; i < lists.size(); ++i) {
+                if(pos[i] < lists[i].size()) next = std::min(next, lists[i][pos[i]]);
+            }
+            if(next == INT_MAX) break;
+            int end = m_start[slot_of(next, 0) + 1];
+            for(int i = 0; i < lists.size(); ++i) {
+                auto first = lists[i].begin() + pos[i], last = std::lower_bound(first, lists[i].end(), end);
+                parts[i].assign(first, last);
+                pos[i] = last - lists[i].begin();
+            }
+            auto merged = detail::or_merge(parts, max_distance);
+            ans.insert(ans.end(), merged.begin(), merged.end());
+        }
+        return ans;
+    }
+    // Windows spanning two documents are dropped along with removed ones.
+    std::vector<int> search(const detail::grouped_data<detail::group_type::AND> &data, int max_distance = 5, unsigned threads = 1) const {
+        for(auto &s : data.strs) {
+            if(s.find(separator) != std::wstring::npos) return {};
+        }
+        auto windows = m_index->windows(data, max_distance, threads);
+        std::vector<int> ans;
+        int slot = 0;
+        for(auto [first, last] : windows) {
+            slot = slot_of(first, slot);
+            if(last < m_start[slot + 1] && !removed(m_slots[slot])) ans.push_back(first);
+        }
+        return ans;
+    }
+
+    // Live documents ranked by BM25 over the terms, best first, at most k.
+    // A term's frequency in each document is counted from its SA interval
+    // through the document array, without materializing or sorting hits.
+    std::vector<ranked_doc> rank(const std::vector<std::wstring> &terms, int k, const bm25_params &params = {}) const {
+        int docs = m_slots.size() - m_dead_docs;
+        if(docs == 0) return {};
+        double avg_len = (double)(m_start.back() - m_dead_chars - docs) / docs;
+        std::vector<detail::scored_postings> lists;
+        std::vector<int> tf(m_slots.size()), touched;
+        for(auto &term : terms) {
+            if(term.empty() || term.size() >= m_index->text().size() || term.find(separator) != std::wstring::npos) continue;
+            auto [l, r] = m_index->locate_interval(term);
+            for(int i = l; i < r; ++i) {
+                if(tf[m_doc_array[i]]++ == 0) touched.push_back(m_doc_array[i]);
+            }
+            std::sort(touched.begin(), touched.end());
+            std::erase_if(touched, [&](int slot) {
+                if(!removed(m_slots[slot])) return false;
+                tf[slot] = 0;
+                return true;
+            });
+            if(!touched.empty()) {
+                auto &list = lists.emplace_back();
+                double idf = detail::bm25_idf(docs, touched.size());
+                for(int slot : touched) {
+                    double score = detail::bm25_score(idf, tf[slot], m_start[slot + 1] - m_start[slot] - 1, avg_len, params);
+                    list.docs.push_back(m_slots[slot]);
+                    list.scores.push_back(score);
+                    list.max_score = std::max(list.max_score, score);
+                    tf[slot] = 0;
+                }
+            }
+            touched.clear();
+        }
+        return detail::wand_top_k(lists, k);
+    }
+
+private:
+    void build(const std::wstring &text) {
+        m_start.push_back(text.size());
+        m_index = std::make_unique<string_data>(text);
+        m_doc_array.resize(text.size());
+        for(int i = 0; i < text.size(); ++i) {
+            int pos = m_index->suffix(i);
+            m_doc_array[i] = std::upper_bound(m_start.begin(), m_start.end(), pos) - m_start.begin() - 1;
+        }
+    }
+    // Slot holding pos, searching forward from a slot at or before it.
+    int slot_of(int pos, int from) const {
+        return std::upper_bound(m_start.begin() + from + 1, m_start.end(), pos) - m_start.begin() - 1;
+    }
+    // Hits come sorted, so the slot lookup only moves forward; with no
+    // tombstones the hits are returned as they are.
+    std::vector<int> live_hits(std::vector<int> hits) const {
+        if(m_dead_chars == 0) return hits;
+        int slot = 0, kept = 0;
+        for(int pos : hits) {
+            slot = slot_of(pos, slot);
+            if(!removed(m_slots[slot])) hits[kept++] = pos;
+        }
+        hits.resize(kept);
+        return hits;
+    }
+
+    double m_compact_fraction;
+    int m_docs;
+    std::vector<uint64_t> m_removed;
+    std::vector<int> m_slots, m_start, m_doc_array;
+    long long m_dead_chars = 0;
+    int m_dead_docs = 0;
+    std::unique_ptr<string_data> m_index;
+};
+
+} // namespace sa_ps
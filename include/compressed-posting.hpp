@@ -0,0 +1,180 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+namespace sa_ps {
+
+// Sorted hit list stored as gaps, bit-packed in blocks of 128 with one bit
+// width per block. Every block has a skip entry holding its last value and
+// where its words start, so cursors only decode the blocks they land in.
+class compressed_posting {
+public:
+    static constexpr int block = 128;
+
+    compressed_posting() {}
+    explicit compressed_posting(std::span<const int> sorted) : m_size(sorted.size()) {
+        int prev = 0;
+        for(int i = 0; i < m_size; i += block) {
+            int len = std::min(block, m_size - i);
+            uint32_t gaps[block], high = 0;
+            for(int j = 0; j < len; ++j) {
+                gaps[j] = sorted[i + j] - prev;
+                prev = sorted[i + j];
+                high |= gaps[j];
+            }
+            int bits = std::bit_width(high);
+            m_skips.push_back({prev, (int)m_words.size(), bits});
+            pack(gaps, len, bits);
+        }
+    }
+
+    class cursor {
+    public:
+        explicit cursor(const compressed_posting &p) : m_p(&p) {
+            load(0);
+        }
+        bool done() const {
+            return m_block >= m_p->m_skips.size();
+        }
+        int value() const {
+            return m_buf[m_pos];
+        }
+        void next() {
+            if(++m_pos == m_len) load(m_block + 1);
+        }
+        // Moves to the first hit >= target, skipping whole blocks undecoded.
+        void advance_to(int target) {
+            if(done() || m_p->m_skips[m_block].last < target) {
+                auto &skips = m_p->m_skips;
+                auto it = std::lower_bound(skips.begin() + std::min<std::size_t>(m_block + 1, skips.size()), skips.end(), target, [](const skip &s, int t) {
+                    return s.last < t;
+                });
+                load(it - skips.begin());
+                if(done()) return;
+            }
+            m_pos = std::lower_bound(m_buf + m_pos, m_buf + m_len, target) - m_buf;
+        }
+    private:
+        void load(int b) {
+            m_block = b;
+            m_pos = 0;
+            if(done()) {
+                m_len = 0;
+                return;
+            }
+            m_len = std::min(block, m_p->m_size - b * block);
+            m_p->decode(b, m_buf);
+        }
+        const compressed_posting *m_p;
+        int m_block = 0, m_pos = 0, m_len = 0;
+        int m_buf[block];
+    };
+
+    int size() const {
+        return m_size;
+    }
+    std::size_t bytes() const {
+        return m_words.size() * sizeof(uint32_t) + m_skips.size() * sizeof(skip);
+    }
+    std::vector<int> to_vector() const {
+        std::vector<int> ans(m_size);
+        for(int b = 0; b < m_skips.size(); ++b) {
+            if(ans.size() - b * block >= block) {
+                decode(b, ans.data() + b * block);
+            } else {
+                int buf[block];
+                decode(b, buf);
+                std::copy(buf, buf + (m_size - b * block), ans.data() + b * block);
+            }
+        }
+        return ans;
+    }
+
+    void write(std::ostream &out) const {
+        int counts[3] = {m_size, (int)m_skips.size(), (int)m_words.size()};
+        out.write((const char *)counts, sizeof(counts));
+        out.write((const char *)m_skips.data(), m_skips.size() * sizeof(skip));
+        out.write((const char *)m_words.data(), m_words.size() * sizeof(uint32_t));
+    }
+    static compressed_posting read(std::istream &in) {
+        compressed_posting p;
+        int counts[3] = {};
+        in.read((char *)counts, sizeof(counts));
+        p.m_size = counts[0];
+        p.m_skips.resize(counts[1]);
+        p.m_words.resize(counts[2]);
+        in.read((char *)p.m_skips.data(), p.m_skips.size() * sizeof(skip));
+        in.read((char *)p.m_words.data(), p.m_words.size() * sizeof(uint32_t));
+        return p;
+    }
+
+private:
+    struct skip {
+        int last;
+        int offset;
+        int bits;
+    };
+
+    // Values are packed LSB first into 32-bit words; the tail of a short last
+    // block is padded with zero gaps so every block is a whole number of words.
+    void pack(const uint32_t *gaps, int len, int bits) {
+        if(bits == 0) return;
+        int start = m_words.size();
+        m_words.resize(start + bits * block / 32);
+        uint32_t *out = m_words.data() + start;
+        for(int j = 0; j < len; ++j) {
+            int bit = j * bits;
+            out[bit >> 5] |= gaps[j] << (bit & 31);
+            if((bit & 31) + bits > 32) out[(bit >> 5) + 1] |= gaps[j] >> (32 - (bit & 31));
+        }
+    }
+    void decode(int b, int *out) const {
+        const skip &s = m_skips[b];
+        int prev = b ? m_skips[b - 1].last : 0;
+        int len = std::min(block, m_size - b * block);
+        if(s.bits == 0) {
+            std::fill(out, out + len, prev);
+            return;
+        }
+        const uint32_t *in = m_words.data() + s.offset;
+        uint32_t mask = s.bits == 32 ? ~0u : (1u << s.bits) - 1;
+        for(int j = 0; j < len; ++j) {
+            int bit = j * s.bits;
+            uint64_t pair = in[bit >> 5];
+            if((bit & 31) + s.bits > 32) pair |= (uint64_t)in[(bit >> 5) + 1] << 32;
+            prev += (pair >> (bit & 31)) & mask;
+            out[j] = prev;
+        }
+    }
+
+    int m_size = 0;
+    std::vector<skip> m_skips;
+    std::vector<uint32_t> m_words;
+};
+
+// Leapfrog intersection: each side jumps to the other's current hit, so long
+// runs of non-matching blocks are never decoded.
+std::vector<int> intersect(const compressed_posting &a, const compressed_posting &b) {
+    std::vector<int> ans;
+    compressed_posting::cursor i(a), j(b);
+    while(!i.done() && !j.done()) {
+        if(i.value() == j.value()) {
+            ans.push_back(i.value());
+            i.next();
+            j.next();
+        } else if(i.value() < j.value()) {
+            i.advance_to(j.value());
+        } else {
+            j.advance_to(i.value());
+        }
+    }
+    return ans;
+}
+
+} // namespace sa_ps
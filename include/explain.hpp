@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+
+namespace sa_ps {
+
+// One executed step of a query, as recorded by string_data::explain_analyze.
+// Times are wall-clock milliseconds; fields that do not apply to a step keep
+// their defaults and are left out of the JSON.
+struct explain_node {
+    std::string op;
+    std::string method;
+    std::wstring term;
+    long long interval = -1;
+    long long probes = 0;
+    std::vector<long long> input_sizes;
+    long long output_size = 0;
+    double lookup_ms = 0, sort_ms = 0, total_ms = 0;
+    std::vector<explain_node> children;
+};
+
+namespace detail {
+
+// Passes every access through to an SA while counting them; sa_interval
+// reads exactly one entry per binary-search probe.
+template<class SA>
+struct counting_sa {
+    const SA &sa;
+    mutable long long probes = 0;
+
+    int operator[](std::size_t i) const {
+        ++probes;
+        return sa[i];
+    }
+    std::size_t size() const {
+        return sa.size();
+    }
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+void append_json(std::string &out, const std::wstring &s) {
+    out += '"';
+    for(wchar_t wc : s) {
+        unsigned c = wc;
+        if(c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        } else if(c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else if(c < 0x80) {
+            out += (char)c;
+        } else if(c < 0x800) {
+            out += (char)(0xC0 | c >> 6);
+            out += (char)(0x80 | (c & 0x3F));
+        } else if(c < 0x10000) {
+            out += (char)(0xE0 | c >> 12);
+            out += (char)(0x80 | (c >> 6 & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        } else {
+            out += (char)(0xF0 | c >> 18);
+            out += (char)(0x80 | (c >> 12 & 0x3F));
+            out += (char)(0x80 | (c >> 6 & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+    }
+    out += '"';
+}
+
+void append_json(std::string &out, const explain_node &node) {
+    char buf[64];
+    out += "{\"op\":\"" + node.op + "\"";
+    if(!node.method.empty()) out += ",\"method\":\"" + node.method + "\"";
+    if(node.op == "term") {
+        out += ",\"term\":";
+        append_json(out, node.term);
+    }
+    if(node.interval >= 0) out += ",\"interval\":" + std::to_string(node.interval);
+    if(node.probes) out += ",\"probes\":" + std::to_string(node.probes);
+    if(!node.input_sizes.empty()) {
+        out += ",\"input_sizes\":[";
+        for(std::size_t i = 0; i < node.input_sizes.size(); ++i) {
+            if(i) out += ',';
+            out += std::to_string(node.input_sizes[i]);
+        }
+        out += ']';
+    }
+    out += ",\"output_size\":" + std::to_string(node.output_size);
+    std::snprintf(buf, sizeof(buf), ",\"lookup_ms\":%.3f,\"sort_ms\":%.3f,\"total_ms\":%.3f", node.lookup_ms, node.sort_ms, node.total_ms);
+    out += buf;
+    if(!node.children.empty()) {
+        out += ",\"children\":[";
+        for(std::size_t i = 0; i < node.children.size(); ++i) {
+            if(i) out += ',';
+            append_json(out, node.children[i]);
+        }
+        out += ']';
+    }
+    out += '}';
+}
+
+} // namespace detail
+
+// Single-line JSON, suitable for a log record.
+std::string to_json(const explain_node &node) {
+    std::string out;
+    detail::append_json(out, node);
+    return out;
+}
+
+} // namespace sa_ps
@@ -1,9 +1,20 @@
 #pragma once
 
 #include "sa-match.hpp"
+#include "set-kernels.hpp"
+#include "aho-corasick.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <numeric>
+#include <algorithm>
+#include <span>
+#include <thread>
+#include <climits>
+#include <queue>
+#include <cmath>
+#include <bit>
+#include <cstdint>
 
 namespace sa_ps {
 
@@ -58,78 +69,293 @@ grouped_data<group_type::OR> operator|(const std::wstring &s1, const grouped_dat
     return result;
 }
 
-std::vector<int> grouped_match(const std::wstring &str, const std::vector<int> &sa, const grouped_data<group_type::AND> &data, int md) {
+struct match_window {
+    int first, last;
+    friend bool operator==(const match_window &, const match_window &) = default;
+};
+
+// Every minimal window [first, last] with last - first <= md that holds a hit
+// of each list. Hits are visited once in position order; a least-recently-hit
+// list of the terms keeps the window start (the oldest last hit) in O(1), and a
+// window is minimal exactly when its start differs from the previous one's.
+std::vector<match_window> cooccurrence(const std::vector<std::span<const int>> &lists, int md) {
+    int n = lists.size();
+    std::vector<match_window> ans;
+    for(auto &list : lists) {
+        if(list.empty()) return ans;
+    }
+    if(md == 0) {
+        std::vector<int> common(lists[0].begin(), lists[0].end());
+        for(int i = 1; i < n; ++i) {
+            common = sorted_intersect(common, lists[i]);
+        }
+        for(int x : common) ans.push_back({x, x});
+        return ans;
+    }
+    using event = std::pair<int, int>;
+    std::priority_queue<event, std::vector<event>, std::greater<event>> heap;
+    std::vector<int> pos(n, 0), last(n, -1), prev(n, -1), next(n, -1);
+    for(int i = 0; i < n; ++i) {
+        heap.push({lists[i][0], i});
+    }
+    int head = -1, tail = -1, seen = 0, start = -1;
+    while(!heap.empty()) {
+        int p = heap.top().first;
+        while(!heap.empty() && heap.top().first == p) {
+            int t = heap.top().second;
+            heap.pop();
+            if(++pos[t] < lists[t].size()) heap.push({lists[t][pos[t]], t});
+            if(last[t] == -1) {
+                ++seen;
+            } else {
+                if(prev[t] != -1) next[prev[t]] = next[t];
+                else head = next[t];
+                if(next[t] != -1) prev[next[t]] = prev[t];
+                else tail = prev[t];
+            }
+            last[t] = p;
+            prev[t] = tail;
+            next[t] = -1;
+            if(tail != -1) next[tail] = t;
+            else head = t;
+            tail = t;
+        }
+        if(seen < n || last[head] == start) continue;
+        start = last[head];
+        if(p - start <= md) ans.push_back({start, p});
+    }
+    return ans;
+}
+
+std::vector<int> or_merge(const std::vector<std::vector<int>> &lists, int md) {
+    if(md == 0 && lists.size() > 2) {
+        // Plain union: mark every hit once instead of merging list by list.
+        int high = -1;
+        for(auto &list : lists) {
+            if(!list.empty()) high = std::max(high, list.back());
+        }
+        std::vector<uint64_t> bits(high / 64 + 1);
+        for(auto &list : lists) {
+            for(int x : list) bits[x >> 6] |= uint64_t(1) << (x & 63);
+        }
+        std::vector<int> ans;
+        for(int w = 0; w < bits.size(); ++w) {
+            for(uint64_t b = bits[w]; b; b &= b - 1) ans.push_back(w << 6 | std::countr_zero(b));
+        }
+        return ans;
+    }
+    std::vector<int> ans = lists[0];
+    for(int i = 1; i < lists.size(); ++i) {
+        ans = window_or(ans, lists[i], md);
+    }
+    return ans;
+}
+
+std::vector<int> window_starts(const std::vector<match_window> &windows) {
+    std::vector<int> ans(windows.size());
+    for(int i = 0; i < windows.size(); ++i) {
+        ans[i] = windows[i].first;
+    }
+    return ans;
+}
+
+// The windows of cooccurrence(lists, md) whose last hit lies in [lo, hi). A
+// window ending at p depends only on hits in [p - md, p], so the slice of hits
+// from lo - md on gives the same windows there; position ranges can thus be
+// evaluated independently, overlapping by md, with no search for cut points.
+std::vector<match_window> cooccurrence_range(const std::vector<std::span<const int>> &lists, int md, int lo, int hi) {
+    int from = lo - std::min(lo, md);
+    std::vector<std::span<const int>> slices;
+    for(auto &list : lists) {
+        auto l = std::lower_bound(list.begin(), list.end(), from);
+        auto r = std::lower_bound(l, list.end(), hi);
+        slices.push_back(list.subspan(l - list.begin(), r - l));
+    }
+    auto ans = cooccurrence(slices, md);
+    ans.erase(ans.begin(), std::partition_point(ans.begin(), ans.end(), [&](const match_window &w) {
+        return w.last < lo;
+    }));
+    return ans;
+}
+
+template<class SA>
+std::vector<match_window> grouped_windows(std::wstring_view str, const SA &sa, const grouped_data<group_type::AND> &data, int md) {
     int n = data.strs.size();
     if(n == 0) {
-        std::vector<int> ans(str.size());
-        std::iota(ans.begin(), ans.end(), 0);
+        std::vector<match_window> ans(str.size());
+        for(int i = 0; i < ans.size(); ++i) {
+            ans[i] = {i, i};
+        }
         return ans;
     }
     std::vector<std::vector<int>> fevery(n);
     for(int i = 0; i < n; ++i) {
         fevery[i] = sa_match(str, sa, data.strs[i]);
     }
-    std::vector<int> ans = fevery[0];
-    std::vector<int> buffer;
-    for(int i = 1; i < n; ++i) {
-        int j = 0, k = 0;
-        while(j < ans.size() && k < fevery[i].size()) {
-            if(abs(ans[j] - fevery[i][k]) <= md) {
-                buffer.push_back(std::min(ans[j], fevery[i][k]));
-                ++j;
-                ++k;
-            } else if(ans[j] < fevery[i][k]) {
-                ++j;
-            } else {
-                ++k;
-            }
-        }
-        std::swap(ans, buffer);
-        buffer.clear();
+    return cooccurrence(std::vector<std::span<const int>>(fevery.begin(), fevery.end()), md);
+}
+// cooccurrence over a text of `len` characters, split into `threads` equal
+// position ranges evaluated concurrently.
+std::vector<match_window> cooccurrence(const std::vector<std::span<const int>> &lists, int md, long long len, unsigned threads) {
+    if(threads <= 1) return cooccurrence(lists, md);
+    std::vector<std::vector<match_window>> results(threads);
+    std::vector<std::thread> workers;
+    for(unsigned p = 0; p < threads; ++p) {
+        workers.emplace_back([&, p] {
+            results[p] = cooccurrence_range(lists, md, len * p / threads, len * (p + 1) / threads);
+        });
+    }
+    for(auto &worker : workers) worker.join();
+    std::vector<match_window> ans;
+    for(auto &result : results) {
+        ans.insert(ans.end(), result.begin(), result.end());
     }
     return ans;
 }
-std::vector<int> grouped_match(const std::wstring &str, const std::vector<int> &sa, const grouped_data<group_type::OR> &data, int md) {
+
+template<class SA>
+std::vector<match_window> grouped_windows(std::wstring_view str, const SA &sa, const grouped_data<group_type::AND> &data, int md, unsigned threads) {
+    int n = data.strs.size();
+    if(n == 0 || threads <= 1) return grouped_windows(str, sa, data, md);
+    std::vector<std::vector<int>> fevery(n);
+    for(int i = 0; i < n; ++i) {
+        fevery[i] = sa_match(str, sa, data.strs[i]);
+    }
+    return cooccurrence(std::vector<std::span<const int>>(fevery.begin(), fevery.end()), md, str.size(), threads);
+}
+template<class SA>
+std::vector<int> grouped_match(std::wstring_view str, const SA &sa, const grouped_data<group_type::AND> &data, int md) {
+    return window_starts(grouped_windows(str, sa, data, md));
+}
+template<class SA>
+std::vector<int> grouped_match(std::wstring_view str, const SA &sa, const grouped_data<group_type::AND> &data, int md, unsigned threads) {
+    return window_starts(grouped_windows(str, sa, data, md, threads));
+}
+// Rough cost, in ns, of producing the hit lists of `terms` patterns with
+// `hits` occurrences in total, measured on hlm.txt: each SA lookup costs ~2 us
+// plus ~70 ns per hit to copy and sort; an Aho-Corasick pass costs
+// 4 + 2 log2(terms) ns per character plus ~35 ns per hit.
+bool prefer_scan(long long len, long long terms, long long hits, unsigned threads) {
+    double lookup = 2000.0 * terms + 70.0 * hits;
+    double scan = (len * (4 + 2 * std::log2(terms + 1.0)) + 35.0 * hits) / std::max(1u, threads);
+    return scan < lookup;
+}
+
+// OR groups narrower than this always use SA lookups; the cost model itself
+// needs one interval lookup per term.
+constexpr int scan_min_terms = 16;
+
+template<class SA>
+std::vector<int> grouped_match(std::wstring_view str, const SA &sa, const grouped_data<group_type::OR> &data, int md, unsigned threads = std::thread::hardware_concurrency()) {
     int n = data.strs.size();
     if(n == 0) {
         std::vector<int> ans(str.size());
         std::iota(ans.begin(), ans.end(), 0);
         return ans;
     }
+    if(n >= scan_min_terms) {
+        long long hits = 0;
+        for(auto &t : data.strs) {
+            if(t.size() < str.size()) {
+                auto [l, r] = sa_interval(str, sa, t, 0, sa.size());
+                hits += r - l;
+            }
+        }
+        if(prefer_scan(str.size(), n, hits, threads)) return or_merge(scan_lists(str, data.strs, threads), md);
+    }
     std::vector<std::vector<int>> fevery(n);
     for(int i = 0; i < n; ++i) {
         fevery[i] = sa_match(str, sa, data.strs[i]);
     }
-    std::vector<int> ans = fevery[0];
-    std::vector<int> buffer;
-    for(int i = 1; i < n; ++i) {
-        int j = 0, k = 0;
-        while(j < ans.size() && k < fevery[i].size()) {
-            if(abs(ans[j] - fevery[i][k]) <= md) {
-                buffer.push_back(std::min(ans[j], fevery[i][k]));
-                ++j;
-                ++k;
-            } else if(ans[j] < fevery[i][k]) {
-                buffer.push_back(ans[j]);
-                ++j;
-            } else {
-                buffer.push_back(fevery[i][k]);
-                ++k;
-            }
-        }
-        while(j < ans.size()) {
-            buffer.push_back(ans[j]);
-            ++j;
+    return or_merge(fevery, md);
+}
+
+// Grouped query over any per-term matcher, for indexes that answer single
+// patterns without a complete suffix array.
+template<group_type Type, class Match>
+std::vector<int> grouped_match_with(int len, const grouped_data<Type> &data, int md, Match &&match) {
+    int n = data.strs.size();
+    if(n == 0) {
+        std::vector<int> ans(len);
+        std::iota(ans.begin(), ans.end(), 0);
+        return ans;
+    }
+    std::vector<std::vector<int>> fevery(n);
+    for(int i = 0; i < n; ++i) {
+        fevery[i] = match(data.strs[i]);
+    }
+    if constexpr(Type == group_type::AND) {
+        return window_starts(cooccurrence(std::vector<std::span<const int>>(fevery.begin(), fevery.end()), md));
+    } else {
+        return or_merge(fevery, md);
+    }
+}
+
+// grouped_match_with under limits. `count` gives a term's hits without
+// materializing them, `match` returns them under the limits it is passed.
+// When the terms' hits do not fit, either nothing is fetched (too_many) or
+// each term keeps its leftmost cap / n hits. Every hit below the first
+// position where a term was cut is then present, so the results that depend
+// only on those hits are exact and the rest are dropped: AND windows ending
+// before it, and OR results at least md per merge before it.
+template<group_type Type, class Count, class Match>
+limited_hits grouped_match_with(int len, const grouped_data<Type> &data, int md, const match_limits &limits, Count &&count, Match &&match) {
+    limited_hits ans;
+    int n = data.strs.size();
+    std::size_t cap = limits.cap();
+    if(n == 0) {
+        ans.total = len;
+        if(ans.total > cap) {
+            ans.status = limits.truncate ? match_status::truncated : match_status::too_many;
+            if(!limits.truncate) return ans;
         }
-        while(k < fevery[i].size()) {
-            buffer.push_back(fevery[i][k]);
-            ++k;
+        ans.hits.resize(std::min<std::size_t>(len, cap));
+        std::iota(ans.hits.begin(), ans.hits.end(), 0);
+        return ans;
+    }
+    for(auto &t : data.strs) {
+        ans.total += count(t);
+    }
+    match_limits term_limits;
+    if(ans.total > cap) {
+        if(!limits.truncate) {
+            ans.status = match_status::too_many;
+            return ans;
         }
-        std::swap(ans, buffer);
-        buffer.clear();
+        term_limits.max_hits = cap / n;
+        term_limits.truncate = true;
     }
+    long long bound = LLONG_MAX;
+    std::vector<std::vector<int>> fevery(n);
+    for(int i = 0; i < n; ++i) {
+        auto part = match(data.strs[i], term_limits);
+        if(part.status == match_status::truncated) bound = std::min<long long>(bound, part.hits.empty() ? 0 : part.hits.back() + 1LL);
+        fevery[i] = std::move(part.hits);
+    }
+    if constexpr(Type == group_type::AND) {
+        auto windows = cooccurrence(std::vector<std::span<const int>>(fevery.begin(), fevery.end()), md);
+        while(!windows.empty() && windows.back().last >= bound) windows.pop_back();
+        ans.hits = window_starts(windows);
+    } else {
+        ans.hits = or_merge(fevery, md);
+        if(bound != LLONG_MAX) bound -= (long long)md * (n - 1);
+        while(!ans.hits.empty() && ans.hits.back() >= bound) ans.hits.pop_back();
+    }
+    if(bound != LLONG_MAX) ans.status = match_status::truncated;
     return ans;
 }
+template<class SA, group_type Type>
+limited_hits grouped_match(std::wstring_view str, const SA &sa, const grouped_data<Type> &data, int md, const match_limits &limits) {
+    auto count = [&](const std::wstring &t) -> std::size_t {
+        if(t.size() >= str.size()) return str == t;
+        auto [l, r] = sa_interval(str, sa, t, 0, str.size());
+        return r - l;
+    };
+    auto match = [&](const std::wstring &t, const match_limits &term_limits) {
+        return sa_match(str, sa, t, term_limits);
+    };
+    return grouped_match_with(str.size(), data, md, limits, count, match);
+}
 
 } // namespace detail
 
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+namespace sa_ps {
+
+// Roaring-style posting list: positions are grouped by their high 16 bits, and
+// each group is stored either as a sorted array of low halves or, once it holds
+// more than 4096 hits, as a 65536-bit bitmap.
+class hybrid_posting {
+public:
+    static constexpr int array_limit = 4096;
+    static constexpr int words = 1024;
+
+    hybrid_posting() {}
+    explicit hybrid_posting(std::span<const int> sorted) {
+        for(int i = 0; i < sorted.size();) {
+            int key = sorted[i] >> 16;
+            int j = i;
+            container c;
+            c.key = key;
+            while(j < sorted.size() && (sorted[j] >> 16) == key) {
+                c.array.push_back(sorted[j] & 0xffff);
+                ++j;
+            }
+            c.card = j - i;
+            c.shrink();
+            m_containers.push_back(std::move(c));
+            i = j;
+        }
+    }
+
+    std::size_t size() const {
+        std::size_t ans = 0;
+        for(auto &c : m_containers) ans += c.card;
+        return ans;
+    }
+    bool empty() const {
+        return m_containers.empty();
+    }
+    bool contains(int x) const {
+        auto it = find(x >> 16);
+        if(it == m_containers.end() || it->key != (x >> 16)) return false;
+        return it->contains(x & 0xffff);
+    }
+    std::size_t bytes() const {
+        std::size_t ans = 0;
+        for(auto &c : m_containers) {
+            ans += sizeof(container) + c.array.size() * sizeof(uint16_t) + c.bits.size() * sizeof(uint64_t);
+        }
+        return ans;
+    }
+    template<class F>
+    void for_each(F &&f) const {
+        for(auto &c : m_containers) {
+            int base = c.key << 16;
+            if(c.is_bitmap()) {
+                for(int w = 0; w < words; ++w) {
+                    for(uint64_t b = c.bits[w]; b; b &= b - 1) {
+                        f(base | (w << 6 | std::countr_zero(b)));
+                    }
+                }
+            } else {
+                for(auto v : c.array) f(base | v);
+            }
+        }
+    }
+    std::vector<int> to_vector() const {
+        std::vector<int> ans;
+        ans.reserve(size());
+        for_each([&](int x) { ans.push_back(x); });
+        return ans;
+    }
+
+    friend hybrid_posting operator&(const hybrid_posting &a, const hybrid_posting &b) {
+        hybrid_posting ans;
+        auto i = a.m_containers.begin(), j = b.m_containers.begin();
+        while(i != a.m_containers.end() && j != b.m_containers.end()) {
+            if(i->key < j->key) {
+                ++i;
+            } else if(i->key > j->key) {
+                ++j;
+            } else {
+                container c = intersect(*i, *j);
+                if(c.card) ans.m_containers.push_back(std::move(c));
+                ++i;
+                ++j;
+            }
+        }
+        return ans;
+    }
+    friend hybrid_posting operator|(const hybrid_posting &a, const hybrid_posting &b) {
+        hybrid_posting ans;
+        auto i = a.m_containers.begin(), j = b.m_containers.begin();
+        while(i != a.m_containers.end() || j != b.m_containers.end()) {
+            if(j == b.m_containers.end() || (i != a.m_containers.end() && i->key < j->key)) {
+                ans.m_containers.push_back(*i++);
+            } else if(i == a.m_containers.end() || j->key < i->key) {
+                ans.m_containers.push_back(*j++);
+            } else {
+                ans.m_containers.push_back(unite(*i, *j));
+                ++i;
+                ++j;
+            }
+        }
+        return ans;
+    }
+
+    // Every position within `md` of some hit, computed word-wise. `md` must be
+    // below 65536 so that a hit only spills into the neighbouring containers.
+    hybrid_posting dilate(int md) const {
+        if(md <= 0) return *this;
+        std::vector<int> keys;
+        for(auto &c : m_containers) {
+            for(int k = c.key - 1; k <= c.key + 1; ++k) {
+                if(k >= 0 && (keys.empty() || keys.back() < k)) keys.push_back(k);
+            }
+        }
+        int pad = (md + 63) / 64;
+        std::vector<uint64_t> buf(words + 2 * pad), tmp(buf.size());
+        hybrid_posting ans;
+        for(int key : keys) {
+            std::fill(buf.begin(), buf.end(), 0);
+            for(int k = key - 1; k <= key + 1; ++k) {
+                auto it = find(k);
+                if(it == m_containers.end() || it->key != k) continue;
+                int offset = (k - key) * words + pad;
+                it->for_each_word([&](int w, uint64_t bits) {
+                    if(w + offset >= 0 && w + offset < buf.size()) buf[w + offset] |= bits;
+                });
+            }
+            for(int r = 0; r < md;) {
+                int s = std::min(2 * r + 1, md - r);
+                shift_or(buf, tmp, s);
+                r += s;
+            }
+            container c;
+            c.key = key;
+            c.bits.assign(buf.begin() + pad, buf.begin() + pad + words);
+            c.card = 0;
+            for(auto w : c.bits) c.card += std::popcount(w);
+            if(!c.card) continue;
+            c.shrink();
+            ans.m_containers.push_back(std::move(c));
+        }
+        return ans;
+    }
+
+    friend bool operator==(const hybrid_posting &a, const hybrid_posting &b) {
+        return a.to_vector() == b.to_vector();
+    }
+
+private:
+    struct container {
+        int key = 0;
+        int card = 0;
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bits;
+
+        bool is_bitmap() const {
+            return !bits.empty();
+        }
+        bool contains(int v) const {
+            if(is_bitmap()) return bits[v >> 6] >> (v & 63) & 1;
+            return std::binary_search(array.begin(), array.end(), v);
+        }
+        template<class F>
+        void for_each_word(F &&f) const {
+            if(is_bitmap()) {
+                for(int w = 0; w < words; ++w) {
+                    if(bits[w]) f(w, bits[w]);
+                }
+            } else {
+                for(auto v : array) f(v >> 6, uint64_t(1) << (v & 63));
+            }
+        }
+        // Picks the cheaper representation for the current cardinality.
+        void shrink() {
+            if(is_bitmap() && card <= array_limit) {
+                array.clear();
+                array.reserve(card);
+                for(int w = 0; w < words; ++w) {
+                    for(uint64_t b = bits[w]; b; b &= b - 1) {
+                        array.push_back(w << 6 | std::countr_zero(b));
+                    }
+                }
+                bits = {};
+            } else if(!is_bitmap() && card > array_limit) {
+                bits.assign(words, 0);
+                for(auto v : array) bits[v >> 6] |= uint64_t(1) << (v & 63);
+                array = {};
+            }
+        }
+    };
+
+    std::vector<container>::const_iterator find(int key) const {
+        return std::lower_bound(m_containers.begin(), m_containers.end(), key, [](const container &c, int k) {
+            return c.key < k;
+        });
+    }
+
+    static container intersect(const container &a, const container &b) {
+        container c;
+        c.key = a.key;
+        if(a.is_bitmap() && b.is_bitmap()) {
+            c.bits.resize(words);
+            for(int w = 0; w < words; ++w) {
+                c.bits[w] = a.bits[w] & b.bits[w];
+                c.card += std::popcount(c.bits[w]);
+            }
+            c.shrink();
+        } else if(a.is_bitmap() || b.is_bitmap()) {
+            const container &arr = a.is_bitmap() ? b : a, &bmp = a.is_bitmap() ? a : b;
+            for(auto v : arr.array) {
+                if(bmp.contains(v)) c.array.push_back(v);
+            }
+            c.card = c.array.size();
+        } else {
+            std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(c.array));
+            c.card = c.array.size();
+        }
+        return c;
+    }
+    static container unite(const container &a, const container &b) {
+        container c;
+        c.key = a.key;
+        if(a.is_bitmap() || b.is_bitmap()) {
+            c.bits.assign(words, 0);
+            a.for_each_word([&](int w, uint64_t bits) { c.bits[w] |= bits; });
+            b.for_each_word([&](int w, uint64_t bits) { c.bits[w] |= bits; });
+            for(auto w : c.bits) c.card += std::popcount(w);
+        } else {
+            std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(c.array));
+            c.card = c.array.size();
+        }
+        c.shrink();
+        return c;
+    }
+    // buf |= (buf << s) | (buf >> s), treating the words as one long bit string.
+    static void shift_or(std::vector<uint64_t> &buf, std::vector<uint64_t> &tmp, int s) {
+        int n = buf.size(), ws = s >> 6, bs = s & 63;
+        std::copy(buf.begin(), buf.end(), tmp.begin());
+        for(int i = 0; i < n; ++i) {
+            uint64_t up = 0, down = 0;
+            if(i - ws >= 0) {
+                up = tmp[i - ws] << bs;
+                if(bs && i - ws - 1 >= 0) up |= tmp[i - ws - 1] >> (64 - bs);
+            }
+            if(i + ws < n) {
+                down = tmp[i + ws] >> bs;
+                if(bs && i + ws + 1 < n) down |= tmp[i + ws + 1] << (64 - bs);
+            }
+            buf[i] |= up | down;
+        }
+    }
+
+    std::vector<container> m_containers;
+};
+
+// Hits of `a` that have a hit of `b` within `md` positions.
+hybrid_posting near(const hybrid_posting &a, const hybrid_posting &b, int md) {
+    return a & b.dilate(md);
+}
+
+} // namespace sa_ps
@@ -0,0 +1,359 @@
+#pragma once
+
+#include "sa-match.hpp"
+#include "packed-array.hpp"
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <system_error>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sa_ps {
+
+namespace detail {
+
+struct hot_list {
+    wchar_t c;
+    int offset, size;
+};
+
+// Every array a string_data answers queries from. The text is followed by a
+// L'\0' in memory, which sa_interval relies on when a suffix is shorter than
+// the pattern. The SA is held either as plain ints or, when packed_sa.width
+// is non-zero, bit-packed, in which case sa is empty.
+struct index_view {
+    std::wstring_view str;
+    std::span<const int> sa, c;
+    packed_span packed_sa;
+    std::span<const bigram_interval> bigrams;
+    std::span<const hot_list> hot;
+    std::span<const int> hot_pos;
+};
+
+// On-disk and shared-memory layout: a fixed header followed by the sections
+// in index_view order, each starting on a 64-byte boundary. The header
+// carries a hash of every section and a hash of itself.
+enum index_section {
+    section_text,
+    section_sa,
+    section_c,
+    section_bigrams,
+    section_hot,
+    section_hot_pos,
+    section_count
+};
+
+struct index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t wchar_size;
+    uint32_t sa_width;
+    uint32_t reserved;
+    uint64_t offset[section_count];
+    uint64_t count[section_count];
+    uint64_t hash[section_count];
+    uint64_t header_hash;
+};
+
+constexpr char index_magic[8] = {'S', 'A', 'P', 'S', 'I', 'D', 'X', '\0'};
+constexpr uint32_t index_version = 3;
+
+// Four independent multiply-rotate lanes over 8-byte words; not
+// cryptographic, only meant to catch torn writes and bit rot.
+uint64_t hash_bytes(const char *p, uint64_t n, uint64_t seed) {
+    constexpr uint64_t k1 = 0x9E3779B97F4A7C15ull, k2 = 0xBF58476D1CE4E5B9ull;
+    uint64_t h[4] = {seed, seed + k1, seed + 2 * k1, seed + 3 * k1};
+    auto word = [&](uint64_t at, uint64_t len) {
+        uint64_t w = 0;
+        std::memcpy(&w, p + at, len);
+        return w;
+    };
+    uint64_t i = 0;
+    for(; i + 32 <= n; i += 32) {
+        for(int l = 0; l < 4; ++l) {
+            h[l] = std::rotl(h[l] ^ word(i + 8 * l, 8) * k1, 29) * k2;
+        }
+    }
+    for(int l = 0; i < n; i += 8, ++l) {
+        h[l] = std::rotl(h[l] ^ word(i, std::min<uint64_t>(8, n - i)) * k1, 29) * k2;
+    }
+    uint64_t x = n;
+    for(int l = 0; l < 4; ++l) {
+        x = std::rotl(x ^ h[l], 31) * k1;
+    }
+    x ^= x >> 32;
+    x *= k2;
+    return x ^ x >> 29;
+}
+
+// Sections are hashed in 1 MiB chunks spread over threads, and a section's
+// hash is the hash of its chunk hashes, so the result does not depend on
+// the thread count.
+std::vector<uint64_t> hash_sections(const std::span<const char> (&sections)[section_count], unsigned threads) {
+    constexpr uint64_t chunk = 1 << 20;
+    std::vector<std::pair<int, uint64_t>> tasks;
+    std::vector<std::vector<uint64_t>> chunks(section_count);
+    for(int i = 0; i < section_count; ++i) {
+        uint64_t pieces = (sections[i].size() + chunk - 1) / chunk;
+        chunks[i].resize(pieces);
+        for(uint64_t j = 0; j < pieces; ++j) tasks.push_back({i, j});
+    }
+    std::atomic<std::size_t> next = 0;
+    auto work = [&] {
+        for(std::size_t t; (t = next++) < tasks.size();) {
+            auto [i, j] = tasks[t];
+            uint64_t at = j * chunk, len = std::min<uint64_t>(chunk, sections[i].size() - at);
+            chunks[i][j] = hash_bytes(sections[i].data() + at, len, j);
+        }
+    };
+    threads = std::max(1u, std::min<unsigned>(threads, tasks.size()));
+    std::vector<std::thread> workers;
+    for(unsigned id = 1; id < threads; ++id) {
+        workers.emplace_back(work);
+    }
+    work();
+    for(auto &worker : workers) worker.join();
+    std::vector<uint64_t> ans(section_count);
+    for(int i = 0; i < section_count; ++i) {
+        ans[i] = hash_bytes((const char *)chunks[i].data(), chunks[i].size() * sizeof(uint64_t), i);
+    }
+    return ans;
+}
+
+uint64_t hash_header(const index_header &h) {
+    return hash_bytes((const char *)&h, offsetof(index_header, header_hash), section_count);
+}
+
+struct index_layout {
+    index_header header;
+    std::span<const char> sections[section_count];
+    uint64_t bytes;
+};
+
+index_layout layout_index(const index_view &v, unsigned threads = std::thread::hardware_concurrency()) {
+    index_layout layout = {};
+    std::memcpy(layout.header.magic, index_magic, sizeof(index_magic));
+    layout.header.version = index_version;
+    layout.header.wchar_size = sizeof(wchar_t);
+    layout.sections[section_text] = {(const char *)v.str.data(), (v.str.size() + 1) * sizeof(wchar_t)};
+    layout.header.sa_width = v.packed_sa.width;
+    layout.sections[section_sa] = v.packed_sa.width ? v.packed_sa.bytes() : std::span<const char>((const char *)v.sa.data(), v.sa.size_bytes());
+    layout.sections[section_c] = {(const char *)v.c.data(), v.c.size_bytes()};
+    layout.sections[section_bigrams] = {(const char *)v.bigrams.data(), v.bigrams.size_bytes()};
+    layout.sections[section_hot] = {(const char *)v.hot.data(), v.hot.size_bytes()};
+    layout.sections[section_hot_pos] = {(const char *)v.hot_pos.data(), v.hot_pos.size_bytes()};
+    uint64_t counts[section_count] = {v.str.size(), v.packed_sa.width ? v.packed_sa.size() : v.sa.size(), v.c.size(), v.bigrams.size(), v.hot.size(), v.hot_pos.size()};
+    uint64_t at = (sizeof(index_header) + 63) / 64 * 64;
+    for(int i = 0; i < section_count; ++i) {
+        layout.header.offset[i] = at;
+        layout.header.count[i] = counts[i];
+        at = (at + layout.sections[i].size() + 63) / 64 * 64;
+    }
+    layout.bytes = at;
+    auto hashes = hash_sections(layout.sections, threads);
+    std::copy(hashes.begin(), hashes.end(), layout.header.hash);
+    layout.header.header_hash = hash_header(layout.header);
+    return layout;
+}
+
+// Streams the layout through sink(data, size); gaps are written as zeros.
+template<class Sink>
+void write_index(const index_layout &layout, Sink &&sink) {
+    static const char zeros[64] = {};
+    sink((const char *)&layout.header, sizeof(index_header));
+    uint64_t at = sizeof(index_header);
+    for(int i = 0; i < section_count; ++i) {
+        sink(zeros, layout.header.offset[i] - at);
+        sink(layout.sections[i].data(), layout.sections[i].size());
+        at = layout.header.offset[i] + layout.sections[i].size();
+    }
+    sink(zeros, layout.bytes - at);
+}
+
+// The header hash and the lookup tables (C array, bigram intervals, hot
+// lists) are always checked, which costs O(table size); section hashes only
+// when verify is set, since they cost a full read of the mapping.
+index_view read_index(const char *base, uint64_t bytes, bool verify = false, unsigned threads = std::thread::hardware_concurrency()) {
+    if(bytes < sizeof(index_header)) throw std::runtime_error("index too small");
+    const index_header &h = *(const index_header *)base;
+    if(std::memcmp(h.magic, index_magic, sizeof(index_magic)) != 0) throw std::runtime_error("not an index file");
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(h.version != index_version) throw std::runtime_error("unsupported index version");
+    if(h.header_hash != hash_header(h)) throw std::runtime_error("index header checksum mismatch");
+    if(h.wchar_size != sizeof(wchar_t)) throw std::runtime_error("index built with a different wchar_t size");
+    if(h.sa_width > 32) throw std::runtime_error("unsupported packed SA width");
+    std::size_t sizes[section_count] = {sizeof(wchar_t), sizeof(int), sizeof(int), sizeof(bigram_interval), sizeof(hot_list), sizeof(int)};
+    auto at = [&](int i) { return base + h.offset[i]; };
+    std::span<const char> sections[section_count];
+    for(int i = 0; i < section_count; ++i) {
+        if(h.offset[i] % 64 || h.offset[i] > bytes || h.count[i] > bytes) throw std::runtime_error("index section out of bounds");
+        uint64_t size = (h.count[i] + (i == section_text)) * sizes[i];
+        if(i == section_sa && h.sa_width) size = packed_bytes(h.count[i], h.sa_width);
+        if(size > bytes - h.offset[i]) throw std::runtime_error("index section out of bounds");
+        sections[i] = {at(i), (std::size_t)size};
+    }
+    if(verify) {
+        auto hashes = hash_sections(sections, threads);
+        for(int i = 0; i < section_count; ++i) {
+            if(hashes[i] != h.hash[i]) throw std::runtime_error("index section " + std::to_string(i) + " checksum mismatch");
+        }
+    }
+    index_view v;
+    v.str = {(const wchar_t *)at(section_text), (std::size_t)h.count[section_text]};
+    if(h.sa_width) {
+        v.packed_sa = {at(section_sa), (std::size_t)h.count[section_sa], (int)h.sa_width};
+    } else {
+        v.sa = {(const int *)at(section_sa), (std::size_t)h.count[section_sa]};
+    }
+    v.c = {(const int *)at(section_c), (std::size_t)h.count[section_c]};
+    v.bigrams = {(const bigram_interval *)at(section_bigrams), (std::size_t)h.count[section_bigrams]};
+    v.hot = {(const hot_list *)at(section_hot), (std::size_t)h.count[section_hot]};
+    v.hot_pos = {(const int *)at(section_hot_pos), (std::size_t)h.count[section_hot_pos]};
+    if(v.str.data()[v.str.size()] != L'\0' || h.count[section_sa] != v.str.size() || v.c.size() != 65537) throw std::runtime_error("index sections inconsistent");
+    long long n = v.str.size();
+    if(v.c[0] != 0 || v.c[65536] != n) throw std::runtime_error("index C array inconsistent");
+    for(int i = 0; i < 65536; ++i) {
+        if(v.c[i] > v.c[i + 1]) throw std::runtime_error("index C array inconsistent");
+    }
+    for(std::size_t i = 0; i < v.bigrams.size(); ++i) {
+        auto &b = v.bigrams[i];
+        if(b.l < 0 || b.l > b.r || b.r > n || (i > 0 && v.bigrams[i - 1].key >= b.key)) throw std::runtime_error("index bigram table inconsistent");
+    }
+    for(std::size_t i = 0; i < v.hot.size(); ++i) {
+        auto &e = v.hot[i];
+        if((unsigned)e.c >= 65536 || e.offset < 0 || e.size < 0 || (long long)e.offset + e.size > (long long)v.hot_pos.size() || (i > 0 && v.hot[i - 1].c >= e.c)) throw std::runtime_error("index hot lists inconsistent");
+    }
+    return v;
+}
+
+// O(n) check that sa is the suffix array of s and that c matches it: sa must
+// be a permutation, and each adjacent pair must be ordered by first character
+// or, on a tie, by the ranks of the suffixes one position later.
+template<class SA>
+bool validate_suffix_array(std::wstring_view s, const SA &sa, std::span<const int> c) {
+    int n = s.size();
+    if(sa.size() != n) return false;
+    std::vector<int> rank(n + 1, -1);
+    for(int i = 0; i < n; ++i) {
+        if(sa[i] < 0 || sa[i] >= n || rank[sa[i]] != -1) return false;
+        rank[sa[i]] = i;
+    }
+    rank[n] = -1;
+    for(int i = 0; i < n; ++i) {
+        unsigned x = s[sa[i]];
+        if(x + 1 >= c.size() || i < c[x] || i >= c[x + 1]) return false;
+        if(i == 0) continue;
+        int a = sa[i - 1], b = sa[i];
+        if(s[a] > s[b] || (s[a] == s[b] && rank[a + 1] > rank[b + 1])) return false;
+    }
+    return true;
+}
+
+// Read-only or writable view of a whole file descriptor; unmapped on destruction.
+class mapping {
+public:
+    mapping(int fd, uint64_t bytes, bool writable) : m_bytes(bytes) {
+        m_addr = mmap(nullptr, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if(m_addr == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+    mapping(const mapping &) = delete;
+    mapping &operator=(const mapping &) = delete;
+    ~mapping() {
+        munmap(m_addr, m_bytes);
+    }
+    char *data() const {
+        return (char *)m_addr;
+    }
+    uint64_t size() const {
+        return m_bytes;
+    }
+private:
+    void *m_addr;
+    uint64_t m_bytes;
+};
+
+std::shared_ptr<mapping> map_fd(int fd, const char *what) {
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), what);
+    }
+    std::shared_ptr<mapping> m;
+    try {
+        m = std::make_shared<mapping>(fd, st.st_size, false);
+    } catch(...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    return m;
+}
+
+std::shared_ptr<mapping> map_file(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) throw std::system_error(errno, std::generic_category(), path);
+    return map_fd(fd, path.c_str());
+}
+
+std::shared_ptr<mapping> map_shm(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0) throw std::system_error(errno, std::generic_category(), name);
+    return map_fd(fd, name.c_str());
+}
+
+// Creates (or replaces) a POSIX shared-memory object holding the layout.
+// The header, and with it the magic, is written after the sections, so a
+// reader never accepts a half-written index. On Linux, where the objects are
+// files under /dev/shm, the object is filled under a temporary name and
+// renamed over `name`: an attach finds either the old or the new index, and
+// processes attached to the old one keep their mapping. POSIX itself has no
+// rename for shared memory, so elsewhere the old object is unlinked first and
+// an attach racing the publish can fail with ENOENT.
+void publish_shm(const std::string &name, const index_layout &layout) {
+#ifdef __linux__
+    std::string tmp = name + ".tmp." + std::to_string(getpid());
+#else
+    std::string tmp = name;
+    shm_unlink(name.c_str());
+#endif
+    int fd = shm_open(tmp.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0) throw std::system_error(errno, std::generic_category(), tmp);
+    try {
+        if(ftruncate(fd, layout.bytes) != 0) throw std::system_error(errno, std::generic_category(), tmp);
+        mapping m(fd, layout.bytes, true);
+        for(int i = 0; i < section_count; ++i) {
+            std::copy(layout.sections[i].begin(), layout.sections[i].end(), m.data() + layout.header.offset[i]);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(m.data(), &layout.header, sizeof(index_header));
+#ifdef __linux__
+        auto path = [](const std::string &n) {
+            return "/dev/shm/" + n.substr(n.find_first_not_of('/'));
+        };
+        if(std::rename(path(tmp).c_str(), path(name).c_str()) != 0) throw std::system_error(errno, std::generic_category(), name);
+#endif
+    } catch(...) {
+        close(fd);
+        shm_unlink(tmp.c_str());
+        throw;
+    }
+    close(fd);
+}
+
+} // namespace detail
+
+} // namespace sa_ps
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "string-data.hpp"
+#include "online-scan.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <exception>
+
+namespace sa_ps {
+
+// Answers queries from the moment it is constructed: the suffix array is built
+// on a background thread, and until it is published every search falls back to
+// a parallel scan of the text. If the build fails, the scan keeps serving and
+// the failure is reported by wait() and error().
+class lazy_string_data {
+public:
+    explicit lazy_string_data(const std::wstring &str, unsigned threads = std::thread::hardware_concurrency())
+        : m_str(str), m_threads(std::max(1u, threads)), m_builder([this](std::stop_token token) { build(token); }) {}
+
+    bool ready() const {
+        return m_index.load() != nullptr;
+    }
+    // Blocks until the index is published, or the build gave up. Rethrows
+    // what made the build fail, other than cancellation.
+    void wait() const {
+        m_done.wait(false);
+        if(m_error) std::rethrow_exception(m_error);
+    }
+    // What made the build fail, other than cancellation, once it has given
+    // up; null while it runs or after it succeeded.
+    std::exception_ptr error() const {
+        return m_done.load() ? m_error : nullptr;
+    }
+
+    std::vector<int> search(const std::wstring &pattern) const {
+        if(auto index = m_index.load()) return index->search(pattern);
+        return detail::online_match(m_str, pattern, m_threads);
+    }
+    template<detail::group_type Type>
+    std::vector<int> search(const detail::grouped_data<Type> &data, int max_distance = 5) const {
+        if(auto index = m_index.load()) return index->search(data, max_distance);
+        return detail::grouped_match_with(m_str.size(), data, max_distance, [&](const std::wstring &pattern) {
+            return detail::online_match(m_str, pattern, m_threads);
+        });
+    }
+
+private:
+    void build(std::stop_token token) {
+        build_options options;
+        options.cancel = token;
+        try {
+            m_index.store(std::make_shared<const string_data>(m_str, options));
+        } catch(const build_cancelled &) {
+        } catch(...) {
+            m_error = std::current_exception();
+        }
+        // m_error is written before m_done is set and only read after.
+        m_done.store(true);
+        m_done.notify_all();
+    }
+
+    std::wstring m_str;
+    unsigned m_threads;
+    std::atomic<std::shared_ptr<const string_data>> m_index;
+    std::atomic<bool> m_done = false;
+    std::exception_ptr m_error;
+    std::jthread m_builder;
+};
+
+} // namespace sa_ps
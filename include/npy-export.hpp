@@ -0,0 +1,95 @@
+#pragma once
+
+#include "index-file.hpp"
+#include <string>
+#include <span>
+#include <memory>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+
+namespace sa_ps {
+
+static_assert(std::endian::native == std::endian::little, "npy export writes the host's int32 layout as '<i4'");
+static_assert(sizeof(int) == sizeof(int32_t));
+
+// Hit lists and index arrays are exported as NumPy .npy files, version 1.0:
+// the magic "\x93NUMPY", bytes 1 and 0, a little-endian uint16 header length,
+// then the header dictionary
+//     {'descr': '<i4', 'fortran_order': False, 'shape': (N,), }
+// padded with spaces and a final '\n' so the data starts at byte 128,
+// then N little-endian int32 values. np.load(path, mmap_mode='r') maps it
+// without copying; any other reader can skip npy_data_offset bytes and map
+// the rest as a raw int32 array.
+constexpr std::size_t npy_data_offset = 128;
+
+namespace detail {
+
+std::string npy_header(std::size_t count) {
+    std::string dict = "{'descr': '<i4', 'fortran_order': False, 'shape': (" + std::to_string(count) + ",), }";
+    std::string header = "\x93NUMPY";
+    header += '\x01';
+    header += '\x00';
+    uint16_t len = npy_data_offset - 10;
+    if(dict.size() + 1 > len) throw std::length_error("npy header too long");
+    header.append((const char *)&len, 2);
+    header += dict;
+    header.append(len - dict.size() - 1, ' ');
+    header += '\n';
+    return header;
+}
+
+} // namespace detail
+
+// Writes an .npy of count int32 values to path, letting fill write them
+// straight into a shared file mapping. The file is built under a temporary
+// name next to path, synced and renamed over it, so a process still mapping
+// an earlier export keeps that complete copy.
+template<class Fill>
+void write_npy(const std::string &path, std::size_t count, Fill &&fill) {
+    std::string tmp = path + ".tmp." + std::to_string(getpid());
+    int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) throw std::system_error(errno, std::generic_category(), tmp);
+    try {
+        uint64_t bytes = npy_data_offset + count * sizeof(int32_t);
+        if(ftruncate(fd, bytes) != 0) throw std::system_error(errno, std::generic_category(), tmp);
+        {
+            detail::mapping m(fd, bytes, true);
+            auto header = detail::npy_header(count);
+            std::memcpy(m.data(), header.data(), header.size());
+            fill((int32_t *)(m.data() + npy_data_offset));
+        }
+        if(fsync(fd) != 0) throw std::system_error(errno, std::generic_category(), tmp);
+        if(std::rename(tmp.c_str(), path.c_str()) != 0) throw std::system_error(errno, std::generic_category(), path);
+    } catch(...) {
+        close(fd);
+        unlink(tmp.c_str());
+        throw;
+    }
+    close(fd);
+}
+void write_npy(const std::string &path, std::span<const int> values) {
+    write_npy(path, values.size(), [&](int32_t *out) {
+        std::memcpy(out, values.data(), values.size_bytes());
+    });
+}
+
+// Read-only, zero-copy view of an .npy written by write_npy.
+struct npy_view {
+    std::shared_ptr<const detail::mapping> storage;
+    std::span<const int32_t> values;
+};
+
+npy_view map_npy(const std::string &path) {
+    auto m = detail::map_file(path);
+    if(m->size() < npy_data_offset || std::memcmp(m->data(), "\x93NUMPY\x01\x00", 8) != 0) throw std::runtime_error(path + " is not an npy file");
+    std::size_t count = (m->size() - npy_data_offset) / sizeof(int32_t);
+    if(std::string(m->data() + 10, npy_data_offset - 10) != detail::npy_header(count).substr(10)) {
+        throw std::runtime_error(path + " is not a 1-D '<i4' npy file");
+    }
+    return {m, {(const int32_t *)(m->data() + npy_data_offset), count}};
+}
+
+} // namespace sa_ps
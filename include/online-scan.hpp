@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <numeric>
+#include <algorithm>
+#include <bit>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sa_ps {
+
+namespace detail {
+
+// Calls f(p) for every p in [first, last) with *p == c, in order.
+template<class F>
+void scan_char(const wchar_t *first, const wchar_t *last, wchar_t c, F &&f) {
+    const wchar_t *p = first;
+    if constexpr(sizeof(wchar_t) == 4) {
+#if defined(__AVX2__)
+        __m256i needle = _mm256_set1_epi32(c);
+        for(; p + 8 <= last; p += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)p);
+            unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, needle)));
+            for(; mask; mask &= mask - 1) f(p + std::countr_zero(mask));
+        }
+#elif defined(__SSE2__)
+        __m128i needle = _mm_set1_epi32(c);
+        for(; p + 4 <= last; p += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i *)p);
+            unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, needle)));
+            for(; mask; mask &= mask - 1) f(p + std::countr_zero(mask));
+        }
+#endif
+    }
+    for(; p < last; ++p) {
+        if(*p == c) f(p);
+    }
+}
+
+// Index-free equivalent of sa_match: filters candidates on the first character
+// and verifies the rest, with the text split into one range per thread.
+std::vector<int> online_match(std::wstring_view s, std::wstring_view t, unsigned threads) {
+    if(s.size() < t.size()) return {};
+    if(t.empty()) {
+        std::vector<int> ans(s.size());
+        std::iota(ans.begin(), ans.end(), 0);
+        return ans;
+    }
+    int last = s.size() - t.size() + 1;
+    threads = std::max(1u, std::min<unsigned>(threads, last / 65536 + 1));
+    std::vector<std::vector<int>> results(threads);
+    auto scan = [&](unsigned id) {
+        int lo = (long long)last * id / threads, hi = (long long)last * (id + 1) / threads;
+        scan_char(s.data() + lo, s.data() + hi, t[0], [&](const wchar_t *p) {
+            if(std::char_traits<wchar_t>::compare(p + 1, t.data() + 1, t.size() - 1) == 0) {
+                results[id].push_back(p - s.data());
+            }
+        });
+    };
+    std::vector<std::thread> workers;
+    for(unsigned id = 1; id < threads; ++id) {
+        workers.emplace_back(scan, id);
+    }
+    scan(0);
+    for(auto &worker : workers) worker.join();
+    std::vector<int> ans;
+    for(auto &result : results) {
+        ans.insert(ans.end(), result.begin(), result.end());
+    }
+    return ans;
+}
+
+} // namespace detail
+
+} // namespace sa_ps
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+namespace sa_ps {
+
+namespace detail {
+
+// Bits needed for values in [0, n).
+int packed_width(std::size_t n) {
+    return std::max(1, (int)std::bit_width(n > 0 ? n - 1 : 0));
+}
+
+// Bytes needed for count entries of width bits, including the trailing word
+// that lets every read be one unaligned 64-bit load.
+std::size_t packed_bytes(std::size_t count, int width) {
+    return ((uint64_t)count * width + 63) / 64 * 8 + 8;
+}
+
+// Read-only view of non-negative ints stored in `width` bits each,
+// little-endian within a byte stream. An entry starts at most 7 bits into
+// its first byte and is at most 32 bits wide, so one load, shift and mask
+// fetch it without branches.
+struct packed_span {
+    const char *data = nullptr;
+    std::size_t count = 0;
+    int width = 0;
+
+    int operator[](std::size_t i) const {
+        uint64_t bit = (uint64_t)i * width, word;
+        std::memcpy(&word, data + (bit >> 3), 8);
+        return (word >> (bit & 7)) & ((1ull << width) - 1);
+    }
+    std::size_t size() const {
+        return count;
+    }
+    std::span<const char> bytes() const {
+        return {data, packed_bytes(count, width)};
+    }
+};
+
+std::vector<uint64_t> pack(std::span<const int> v, int width) {
+    std::vector<uint64_t> words(packed_bytes(v.size(), width) / 8);
+    for(std::size_t i = 0; i < v.size(); ++i) {
+        uint64_t bit = (uint64_t)i * width, x = (uint32_t)v[i];
+        words[bit / 64] |= x << (bit % 64);
+        if(bit % 64 + width > 64) words[bit / 64 + 1] |= x >> (64 - bit % 64);
+    }
+    return words;
+}
+
+} // namespace detail
+
+} // namespace sa_ps
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "grouped-data.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+namespace sa_ps {
+
+// Single-flight layer over any index with string_data's search interface.
+// Identical queries that arrive while one is running wait for it instead of
+// running again, and all of them receive the same immutable result buffer.
+template<class Index>
+class query_coalescer {
+public:
+    using result = std::shared_ptr<const std::vector<int>>;
+
+    explicit query_coalescer(const Index &index) : m_index(index) {}
+
+    result search(const std::wstring &pattern) {
+        std::wstring key = L"P";
+        append(key, pattern);
+        return run(key, [&] { return m_index.search(pattern); });
+    }
+    template<detail::group_type Type>
+    result search(const detail::grouped_data<Type> &data, int max_distance = 5) {
+        std::wstring key = Type == detail::group_type::AND ? L"A" : L"O";
+        key += std::to_wstring(max_distance);
+        for(auto &s : data.strs) append(key, s);
+        return run(key, [&] { return m_index.search(data, max_distance); });
+    }
+
+    // Number of queries currently executing.
+    int in_flight() const {
+        std::lock_guard lock(m_mutex);
+        return m_flights.size();
+    }
+
+private:
+    // Length-prefixed, so distinct term lists never share a key.
+    static void append(std::wstring &key, const std::wstring &s) {
+        key += L':';
+        key += std::to_wstring(s.size());
+        key += L':';
+        key += s;
+    }
+
+    template<class F>
+    result run(const std::wstring &key, F &&execute) {
+        std::unique_lock lock(m_mutex);
+        if(auto it = m_flights.find(key); it != m_flights.end()) {
+            auto flight = it->second;
+            lock.unlock();
+            return flight.get();
+        }
+        std::promise<result> promise;
+        m_flights.emplace(key, promise.get_future().share());
+        lock.unlock();
+        try {
+            promise.set_value(std::make_shared<const std::vector<int>>(execute()));
+        } catch(...) {
+            promise.set_exception(std::current_exception());
+        }
+        lock.lock();
+        auto flight = m_flights.extract(key).mapped();
+        lock.unlock();
+        return flight.get();
+    }
+
+    const Index &m_index;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::wstring, std::shared_future<result>> m_flights;
+};
+
+} // namespace sa_ps
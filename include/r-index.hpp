@@ -0,0 +1,184 @@
+#pragma once
+
+#include "sa-is.hpp"
+#include "grouped-data.hpp"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+namespace sa_ps {
+
+// Run-length BWT with SA samples at run boundaries (Gagie, Navarro and
+// Prezza's r-index). Everything kept is O(r) for r BWT runs, plus the
+// distinct characters, so near-identical revisions of a text cost little more
+// than one copy. The text itself is not stored.
+//
+// count() is a backward search over the runs. search() also carries the SA
+// value of the last row of the range through the backward search (the
+// "toehold"), then walks the range with phi(p) = SA[ISA[p] - 1], which the
+// samples answer for any p by one binary search.
+class r_index {
+public:
+    explicit r_index(const std::wstring &str) : m_n(str.size()) {
+        std::vector<int> sa(m_n + 1);
+        sa[0] = m_n;
+        auto body = detail::suffix_array(str);
+        std::copy(body.begin(), body.end(), sa.begin() + 1);
+        auto bwt = [&](int i) -> int {
+            return sa[i] > 0 ? (unsigned)str[sa[i] - 1] : sentinel;
+        };
+
+        std::vector<int> freq(65536);
+        for(wchar_t ch : str) {
+            ++freq[(unsigned)ch];
+        }
+        std::vector<int> first(65536);
+        int below = 1;
+        for(int ch = 0; ch < 65536; ++ch) {
+            first[ch] = below;
+            if(freq[ch] == 0) continue;
+            m_chars.push_back(ch);
+            m_c.push_back(below);
+            below += freq[ch];
+        }
+        m_c.push_back(below);
+
+        std::vector<int> seen(65536);
+        std::vector<std::pair<int, int>> phi;
+        for(int i = 0; i <= m_n; ++i) {
+            int ch = bwt(i);
+            if(i == 0 || ch != m_run_char.back()) {
+                if(i > 0) m_end_sample.push_back(sa[i - 1]);
+                m_run_start.push_back(i);
+                m_run_char.push_back(ch);
+                if(sa[i] > 0) phi.push_back({sa[i] - 1, sa[first[ch] + seen[ch] - 1]});
+            }
+            if(ch != sentinel) ++seen[ch];
+        }
+        m_end_sample.push_back(sa[m_n]);
+        m_run_start.push_back(m_n + 1);
+        std::sort(phi.begin(), phi.end());
+        for(auto [key, value] : phi) {
+            m_phi_key.push_back(key);
+            m_phi_value.push_back(value);
+        }
+
+        // Runs of each character in BWT order, with the number of that
+        // character in the BWT before each of them.
+        m_char_first.assign(m_chars.size() + 1, 0);
+        for(int k = 0; k < runs(); ++k) {
+            if(m_run_char[k] != sentinel) ++m_char_first[char_id(m_run_char[k]) + 1];
+        }
+        std::partial_sum(m_char_first.begin(), m_char_first.end(), m_char_first.begin());
+        m_char_runs.resize(m_char_first.back());
+        m_char_before.resize(m_char_first.back());
+        auto fill = m_char_first;
+        std::vector<int> total(m_chars.size());
+        for(int k = 0; k < runs(); ++k) {
+            if(m_run_char[k] == sentinel) continue;
+            int id = char_id(m_run_char[k]);
+            m_char_runs[fill[id]] = k;
+            m_char_before[fill[id]++] = total[id];
+            total[id] += m_run_start[k + 1] - m_run_start[k];
+        }
+    }
+
+    int runs() const {
+        return m_run_char.size();
+    }
+    std::size_t bytes() const {
+        return (m_run_start.size() + m_run_char.size() + m_end_sample.size() + m_phi_key.size() + m_phi_value.size()
+                + m_char_runs.size() + m_char_before.size() + m_char_first.size() + m_c.size()) * sizeof(int)
+               + m_chars.size() * sizeof(wchar_t);
+    }
+
+    int count(const std::wstring &pattern) const {
+        if(pattern.empty()) return m_n;
+        int sp = 0, ep = m_n + 1;
+        for(int i = pattern.size() - 1; i >= 0 && sp < ep; --i) {
+            int id = char_id(pattern[i]);
+            if(id == -1) return 0;
+            sp = m_c[id] + rank(id, sp);
+            ep = m_c[id] + rank(id, ep);
+        }
+        return std::max(0, ep - sp);
+    }
+
+    std::vector<int> search(const std::wstring &pattern) const {
+        std::vector<int> ans;
+        if(pattern.empty()) {
+            ans.resize(m_n);
+            std::iota(ans.begin(), ans.end(), 0);
+            return ans;
+        }
+        int sp = 0, ep = m_n + 1, toehold = m_end_sample.back();
+        for(int i = pattern.size() - 1; i >= 0; --i) {
+            int id = char_id(pattern[i]);
+            if(id == -1) return ans;
+            int last = run_of(ep - 1);
+            if(m_run_char[last] != (int)(unsigned)pattern[i]) {
+                int m = runs_before(id, last);
+                if(m == 0) return ans;
+                int k = m_char_runs[m_char_first[id] + m - 1];
+                if(m_run_start[k + 1] <= sp) return ans;
+                toehold = m_end_sample[k];
+            }
+            --toehold;
+            sp = m_c[id] + rank(id, sp);
+            ep = m_c[id] + rank(id, ep);
+            if(sp >= ep) return ans;
+        }
+        ans.resize(ep - sp);
+        ans.back() = toehold;
+        for(int i = ans.size() - 2; i >= 0; --i) {
+            ans[i] = phi(ans[i + 1]);
+        }
+        std::sort(ans.begin(), ans.end());
+        return ans;
+    }
+    template<detail::group_type Type>
+    std::vector<int> search(const detail::grouped_data<Type> &data, int max_distance = 5) const {
+        return detail::grouped_match_with(m_n, data, max_distance, [&](const std::wstring &pattern) {
+            return search(pattern);
+        });
+    }
+
+private:
+    static constexpr int sentinel = -1;
+
+    int char_id(wchar_t ch) const {
+        auto it = std::lower_bound(m_chars.begin(), m_chars.end(), (int)(unsigned)ch);
+        return it != m_chars.end() && *it == (int)(unsigned)ch ? it - m_chars.begin() : -1;
+    }
+    int run_of(int i) const {
+        return std::upper_bound(m_run_start.begin(), m_run_start.end(), i) - m_run_start.begin() - 1;
+    }
+    // Runs of character id among the first k runs.
+    int runs_before(int id, int k) const {
+        auto first = m_char_runs.begin() + m_char_first[id], last = m_char_runs.begin() + m_char_first[id + 1];
+        return std::lower_bound(first, last, k) - first;
+    }
+    // Occurrences of character id in BWT[0, i).
+    int rank(int id, int i) const {
+        if(i == 0) return 0;
+        int k = run_of(i - 1), m = runs_before(id, k);
+        int before = m < m_char_first[id + 1] - m_char_first[id] ? m_char_before[m_char_first[id] + m] : m_c[id + 1] - m_c[id];
+        if(m_run_char[k] == m_chars[id]) before += i - m_run_start[k];
+        return before;
+    }
+    // SA[ISA[p] - 1]. Rows inside a run map to adjacent rows under LF, so
+    // phi(p) = phi(q) - (q - p) for the nearest sampled q >= p.
+    int phi(int p) const {
+        int k = std::lower_bound(m_phi_key.begin(), m_phi_key.end(), p) - m_phi_key.begin();
+        return m_phi_value[k] - (m_phi_key[k] - p);
+    }
+
+    int m_n;
+    std::vector<int> m_chars, m_c;
+    std::vector<int> m_run_start, m_run_char, m_end_sample;
+    std::vector<int> m_phi_key, m_phi_value;
+    std::vector<int> m_char_first, m_char_runs, m_char_before;
+};
+
+} // namespace sa_ps
@@ -2,14 +2,82 @@
 
 #include <string>
 #include <vector>
+#include <functional>
+#include <stdexcept>
+#include <stop_token>
+#include <chrono>
 
 namespace sa_ps {
 
+enum class build_phase {
+    classify,
+    induce_lms,
+    rename,
+    induce
+};
+
+struct build_progress {
+    build_phase phase;
+    int level;
+    double fraction;
+};
+
+// Progress is reported and the token and budget are checked every 65536 steps
+// of the sa_is loops, so an abort takes effect within milliseconds; the
+// token and budget are checked again between the stages string_data runs
+// after the SA. An abort throws build_cancelled.
+struct build_options {
+    std::function<void(const build_progress &)> progress;
+    std::stop_token cancel;
+    std::chrono::steady_clock::duration time_budget = std::chrono::steady_clock::duration::zero();
+    // Characters whose text-ordered hit lists are kept ready for search().
+    int hot_chars = 32;
+    // Store the SA in ceil(log2 n) bits per entry instead of 32.
+    bool pack_sa = false;
+};
+
+class build_cancelled : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
 namespace detail {
 
+struct build_context {
+    const build_options &options;
+    std::chrono::steady_clock::time_point deadline;
+
+    explicit build_context(const build_options &_options) : options(_options) {
+        if(options.time_budget > std::chrono::steady_clock::duration::zero()) {
+            deadline = std::chrono::steady_clock::now() + options.time_budget;
+        }
+    }
+    void check() const {
+        if(options.cancel.stop_requested()) {
+            throw build_cancelled("suffix array build cancelled");
+        }
+        if(deadline != std::chrono::steady_clock::time_point() && std::chrono::steady_clock::now() > deadline) {
+            throw build_cancelled("suffix array build exceeded its time budget");
+        }
+    }
+    void step(build_phase phase, int level, long long done, long long total) {
+        check();
+        if(options.progress) {
+            options.progress({phase, level, total ? (double)done / total : 1.0});
+        }
+    }
+};
+
 // modified from https://github.com/atcoder/ac-library/blob/master/atcoder/string.hpp
-std::vector<int> sa_is(const std::vector<int> &s, int upper) {
+// If `buckets` is given, it receives the start of each character's SA interval,
+// plus n at the end.
+std::vector<int> sa_is(const std::vector<int> &s, int upper, build_context *ctx = nullptr, int level = 0, std::vector<int> *buckets = nullptr) {
     int n = s.size();
+    if(buckets && n <= 2) {
+        buckets->assign(upper + 2, 0);
+        for(int c : s) ++(*buckets)[c + 1];
+        for(int i = 0; i <= upper; i++) (*buckets)[i + 1] += (*buckets)[i];
+    }
     if(n == 0) return {};
     if(n == 1) return {0};
     if(n == 2) {
@@ -20,13 +88,19 @@ std::vector<int> sa_is(const std::vector<int> &s, int upper) {
         }
     }
 
+    auto check = [&](int i, build_phase phase, long long done, long long total) {
+        if(ctx && !(i & 0xffff)) ctx->step(phase, level, done, total);
+    };
+
     std::vector<int> sa(n);
     std::vector<bool> ls(n);
     for(int i = n - 2; i >= 0; i--) {
+        check(i, build_phase::classify, n - i, 4LL * n);
         ls[i] = (s[i] == s[i + 1]) ? ls[i + 1] : (s[i] < s[i + 1]);
     }
     std::vector<int> sum_l(upper + 1), sum_s(upper + 1);
     for(int i = 0; i < n; i++) {
+        check(i, build_phase::classify, n + i, 4LL * n);
         if(!ls[i]) {
             sum_s[s[i]]++;
         } else {
@@ -37,18 +111,25 @@ std::vector<int> sa_is(const std::vector<int> &s, int upper) {
         sum_s[i] += sum_l[i];
         if(i < upper) sum_l[i + 1] += sum_s[i];
     }
+    if(buckets) {
+        buckets->assign(sum_l.begin(), sum_l.end());
+        buckets->push_back(n);
+    }
 
-    auto induce = [&](const std::vector<int> &lms) {
+    auto induce = [&](const std::vector<int> &lms, build_phase phase) {
         std::fill(sa.begin(), sa.end(), -1);
         std::vector<int> buf(upper + 1);
         std::copy(sum_s.begin(), sum_s.end(), buf.begin());
-        for(auto d : lms) {
+        for(int i = 0; i < lms.size(); i++) {
+            check(i, phase, i, 2LL * n + lms.size());
+            int d = lms[i];
             if(d == n) continue;
             sa[buf[s[d]]++] = d;
         }
         std::copy(sum_l.begin(), sum_l.end(), buf.begin());
         sa[buf[s[n - 1]]++] = n - 1;
         for(int i = 0; i < n; i++) {
+            check(i, phase, lms.size() + i, 2LL * n + lms.size());
             int v = sa[i];
             if(v >= 1 && !ls[v - 1]) {
                 sa[buf[s[v - 1]]++] = v - 1;
@@ -56,6 +137,7 @@ std::vector<int> sa_is(const std::vector<int> &s, int upper) {
         }
         std::copy(sum_l.begin(), sum_l.end(), buf.begin());
         for(int i = n - 1; i >= 0; i--) {
+            check(i, phase, lms.size() + 2LL * n - i, 2LL * n + lms.size());
             int v = sa[i];
             if(v >= 1 && ls[v - 1]) {
                 sa[--buf[s[v - 1] + 1]] = v - 1;
@@ -66,6 +148,7 @@ std::vector<int> sa_is(const std::vector<int> &s, int upper) {
     std::vector<int> lms_map(n + 1, -1);
     int m = 0;
     for(int i = 1; i < n; i++) {
+        check(i, build_phase::classify, 2LL * n + i, 4LL * n);
         if(!ls[i - 1] && ls[i]) {
             lms_map[i] = m++;
         }
@@ -73,23 +156,26 @@ std::vector<int> sa_is(const std::vector<int> &s, int upper) {
     std::vector<int> lms;
     lms.reserve(m);
     for(int i = 1; i < n; i++) {
+        check(i, build_phase::classify, 3LL * n + i, 4LL * n);
         if(!ls[i - 1] && ls[i]) {
             lms.push_back(i);
         }
     }
 
-    induce(lms);
+    induce(lms, build_phase::induce_lms);
 
     if(m) {
         std::vector<int> sorted_lms;
         sorted_lms.reserve(m);
-        for(int v : sa) {
-            if(lms_map[v] != -1) sorted_lms.push_back(v);
+        for(int i = 0; i < n; i++) {
+            check(i, build_phase::rename, i, 2LL * n);
+            if(lms_map[sa[i]] != -1) sorted_lms.push_back(sa[i]);
         }
         std::vector<int> rec_s(m);
         int rec_upper = 0;
         rec_s[lms_map[sorted_lms[0]]] = 0;
         for(int i = 1; i < m; i++) {
+            check(i, build_phase::rename, n + (long long)n * i / m, 2LL * n);
             int l = sorted_lms[i - 1], r = sorted_lms[i];
             int end_l = (lms_map[l] + 1 < m) ? lms[lms_map[l] + 1] : n;
             int end_r = (lms_map[r] + 1 < m) ? lms[lms_map[r] + 1] : n;
@@ -110,19 +196,29 @@ std::vector<int> sa_is(const std::vector<int> &s, int upper) {
             rec_s[lms_map[sorted_lms[i]]] = rec_upper;
         }
 
-        auto rec_sa = sa_is(rec_s, rec_upper);
+        auto rec_sa = sa_is(rec_s, rec_upper, ctx, level + 1);
 
         for(int i = 0; i < m; i++) {
             sorted_lms[i] = lms[rec_sa[i]];
         }
-        induce(sorted_lms);
+        induce(sorted_lms, build_phase::induce);
     }
     return sa;
 }
 
-std::vector<int> suffix_array(const std::wstring &str) {
+std::vector<int> suffix_array(const std::wstring &str, std::vector<int> *buckets = nullptr) {
+    std::vector<int> nums(str.begin(), str.end());
+    return sa_is(nums, 65535, nullptr, 0, buckets);
+}
+std::vector<int> suffix_array(const std::wstring &str, build_context &ctx, std::vector<int> *buckets = nullptr) {
     std::vector<int> nums(str.begin(), str.end());
-    return sa_is(nums, 65535);
+    auto sa = sa_is(nums, 65535, &ctx, 0, buckets);
+    if(ctx.options.progress) ctx.options.progress({build_phase::induce, 0, 1.0});
+    return sa;
+}
+std::vector<int> suffix_array(const std::wstring &str, const build_options &options, std::vector<int> *buckets = nullptr) {
+    build_context ctx(options);
+    return suffix_array(str, ctx, buckets);
 }
 
 } // namespace detail
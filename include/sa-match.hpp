@@ -1,24 +1,28 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <span>
 #include <vector>
 #include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
 
 namespace sa_ps {
 
 namespace detail {
 
-std::vector<int> sa_match(const std::wstring &s, const std::vector<int> &sa, const std::wstring &t) {
-    if(s.size() < t.size()) return {};
-    if(s.size() == t.size()) {
-        if(s == t) return {0};
-        return {};
-    }
-    int n = s.size();
+// Half-open range of sa[lo, hi) whose suffixes start with t; sa[lo, hi) must
+// be sorted. SA is any indexable array of suffix positions: a span, a vector
+// or a packed_span.
+template<class SA>
+std::pair<int, int> sa_interval(std::wstring_view s, const SA &sa, std::wstring_view t, int lo, int hi) {
     const wchar_t *__restrict ps = s.data();
     const wchar_t *__restrict pt = t.data();
     auto bin = [&](bool first) -> int {
-        int l = 0, r = n - 1, ans = -1;
+        int l = lo, r = hi - 1, ans = -1;
         while(l <= r) {
             int mid = (l + r) / 2;
             int cmp = std::char_traits<wchar_t>::compare(ps + sa[mid], pt, t.size());
@@ -34,15 +38,172 @@ std::vector<int> sa_match(const std::wstring &s, const std::vector<int> &sa, con
         }
         return ans;
     };
-    int ansl = bin(true), ansr = bin(false);
-    if(ansl == -1) return {};
-    std::vector<int> ans(ansr - ansl + 1);
-    for(int i = ansl, j = 0; i <= ansr; ++i, ++j) {
-        ans[j] = sa[i];
+    int ansl = bin(true);
+    if(ansl == -1) return {lo, lo};
+    return {ansl, bin(false) + 1};
+}
+
+struct bigram_interval {
+    uint32_t key;
+    int l, r;
+};
+
+uint32_t bigram_key(wchar_t a, wchar_t b) {
+    return (uint32_t)a << 16 | (uint16_t)b;
+}
+
+// Suffixes sharing their first two characters are adjacent in the SA, so one
+// pass over it yields every bigram's interval, already sorted by key.
+template<class SA>
+std::vector<bigram_interval> bigram_table(std::wstring_view s, const SA &sa) {
+    std::vector<bigram_interval> ans;
+    int n = s.size();
+    for(int i = 0; i < n; ++i) {
+        if(sa[i] + 1 >= n) continue;
+        uint32_t key = bigram_key(s[sa[i]], s[sa[i] + 1]);
+        if(ans.empty() || ans.back().key != key) ans.push_back({key, i, i});
+        ans.back().r = i + 1;
+    }
+    return ans;
+}
+
+// Per-character tables have 65536 entries, so indexed text must stay in the
+// BMP; with a 32-bit wchar_t a character above U+FFFF is rejected up front.
+void check_bmp(std::wstring_view s) {
+    for(wchar_t c : s) {
+        if((unsigned)c >= 65536) throw std::invalid_argument("text contains a character above U+FFFF");
+    }
+}
+
+// Keys hold 16 bits per character; the text is BMP-only, so a bigram with a
+// character above U+FFFF cannot occur.
+std::pair<int, int> bigram_lookup(std::span<const bigram_interval> table, wchar_t a, wchar_t b) {
+    if((unsigned)a >= 65536 || (unsigned)b >= 65536) return {0, 0};
+    uint32_t key = bigram_key(a, b);
+    auto it = std::lower_bound(table.begin(), table.end(), key, [](const bigram_interval &e, uint32_t k) {
+        return e.key < k;
+    });
+    if(it == table.end() || it->key != key) return {0, 0};
+    return {it->l, it->r};
+}
+
+// Kasai et al.: lcp[i] is the longest common prefix of the suffixes at sa[i - 1]
+// and sa[i], and lcp[0] is 0. Writes s.size() entries to lcp.
+template<class SA>
+void lcp_array(std::wstring_view s, const SA &sa, int *lcp) {
+    int n = s.size();
+    std::vector<int> rank(n);
+    for(int i = 0; i < n; ++i) {
+        rank[sa[i]] = i;
+    }
+    if(n > 0) lcp[0] = 0;
+    for(int p = 0, h = 0; p < n; ++p) {
+        if(h > 0) --h;
+        if(rank[p] == 0) {
+            h = 0;
+            continue;
+        }
+        int q = sa[rank[p] - 1];
+        while(p + h < n && q + h < n && s[p + h] == s[q + h]) ++h;
+        lcp[rank[p]] = h;
+    }
+}
+
+// Caps on what one query may materialize. max_bytes counts the int positions
+// of the result and of any intermediate hit lists. A query over the caps
+// either allocates nothing and reports too_many, or, with truncate set, keeps
+// the leftmost hits that fit.
+struct match_limits {
+    std::size_t max_hits = SIZE_MAX;
+    std::size_t max_bytes = SIZE_MAX;
+    bool truncate = false;
+
+    std::size_t cap() const {
+        return std::min(max_hits, max_bytes / sizeof(int));
+    }
+};
+
+enum class match_status {
+    complete,
+    truncated,
+    too_many
+};
+
+// total is the number of hits the query's SA intervals hold, known before
+// anything is copied out of the SA.
+struct limited_hits {
+    std::vector<int> hits;
+    match_status status = match_status::complete;
+    std::size_t total = 0;
+};
+
+// Positions sa[l, r) in text order. Over the cap, the leftmost cap of them are
+// selected with a bounded max-heap, so memory never exceeds the cap.
+template<class SA>
+limited_hits limited_interval(const SA &sa, int l, int r, const match_limits &limits) {
+    limited_hits ans;
+    ans.total = r - l;
+    std::size_t cap = limits.cap();
+    if(ans.total <= cap) {
+        ans.hits.resize(r - l);
+        for(int i = l; i < r; ++i) {
+            ans.hits[i - l] = sa[i];
+        }
+        std::sort(ans.hits.begin(), ans.hits.end());
+        return ans;
+    }
+    if(!limits.truncate) {
+        ans.status = match_status::too_many;
+        return ans;
+    }
+    ans.status = match_status::truncated;
+    if(cap == 0) return ans;
+    ans.hits.reserve(cap);
+    for(int i = l; i < r; ++i) {
+        int p = sa[i];
+        if(ans.hits.size() < cap) {
+            ans.hits.push_back(p);
+            std::push_heap(ans.hits.begin(), ans.hits.end());
+        } else if(p < ans.hits.front()) {
+            std::pop_heap(ans.hits.begin(), ans.hits.end());
+            ans.hits.back() = p;
+            std::push_heap(ans.hits.begin(), ans.hits.end());
+        }
+    }
+    std::sort_heap(ans.hits.begin(), ans.hits.end());
+    return ans;
+}
+
+template<class SA>
+std::vector<int> sa_match(std::wstring_view s, const SA &sa, std::wstring_view t) {
+    if(s.size() < t.size()) return {};
+    if(s.size() == t.size()) {
+        if(s == t) return {0};
+        return {};
+    }
+    auto [ansl, ansr] = sa_interval(s, sa, t, 0, s.size());
+    std::vector<int> ans(ansr - ansl);
+    for(int i = ansl; i < ansr; ++i) {
+        ans[i - ansl] = sa[i];
     }
     std::sort(ans.begin(), ans.end());
     return ans;
 }
+template<class SA>
+limited_hits sa_match(std::wstring_view s, const SA &sa, std::wstring_view t, const match_limits &limits) {
+    if(s.size() <= t.size()) {
+        limited_hits ans;
+        ans.hits = sa_match(s, sa, t);
+        ans.total = ans.hits.size();
+        if(ans.total > limits.cap()) {
+            ans.status = limits.truncate ? match_status::truncated : match_status::too_many;
+            ans.hits.clear();
+        }
+        return ans;
+    }
+    auto [l, r] = sa_interval(s, sa, t, 0, s.size());
+    return limited_interval(sa, l, r, limits);
+}
 
 } // namespace detail
 
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "sa-is.hpp"
+#include <string_view>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+namespace sa_ps {
+
+namespace detail {
+
+// Backward search of every suffix of a·b that starts in a against the
+// suffixes of b. Entry k is the number of suffixes of b, counting the empty
+// one, that are smaller than a[k..]·b; entry |a| is that count for b itself.
+template<class SA>
+std::vector<int> merge_gaps(std::wstring_view a, std::wstring_view b, const SA &sa_b) {
+    int n = b.size();
+    std::vector<int> c(65537);
+    for(wchar_t ch : b) {
+        ++c[(unsigned)ch + 1];
+    }
+    std::partial_sum(c.begin(), c.end(), c.begin());
+    // Suffixes of b in order, the empty one first, grouped by the character
+    // preceding them: occ[c[x] .. c[x + 1]) lists, ascending, the ranks of the
+    // suffixes preceded by x.
+    std::vector<int> occ(n), fill(c.begin(), c.end() - 1);
+    int rank_b = 0;
+    if(n > 0) occ[fill[(unsigned)b[n - 1]]++] = 0;
+    for(int k = 0; k < n; ++k) {
+        int p = sa_b[k];
+        if(p == 0) rank_b = k + 1;
+        else occ[fill[(unsigned)b[p - 1]]++] = k + 1;
+    }
+    std::vector<int> gap(a.size() + 1);
+    gap[a.size()] = rank_b;
+    for(int k = (int)a.size() - 1; k >= 0; --k) {
+        unsigned x = a[k];
+        auto first = occ.begin() + c[x], last = occ.begin() + c[x + 1];
+        gap[k] = 1 + c[x] + (std::lower_bound(first, last, gap[k + 1]) - first);
+    }
+    return gap;
+}
+
+// Longest suffix of a that also starts somewhere else in a, or -1 if it is
+// longer than limit. Such a suffix is a prefix of its successor in sa_a, and
+// so is every shorter suffix.
+template<class SA>
+int repeated_suffix(std::wstring_view a, const SA &sa_a, int limit) {
+    int n = a.size();
+    limit = std::min(limit, n);
+    std::vector<int> rank(limit + 1, -1);
+    for(int k = 0; k < n; ++k) {
+        if(sa_a[k] >= n - limit) rank[sa_a[k] - (n - limit)] = k;
+    }
+    int len = 0;
+    while(len < limit) {
+        int j = n - len - 1, r = rank[j - (n - limit)];
+        if(r + 1 >= n) break;
+        int i = sa_a[r + 1];
+        if(a.substr(i, len + 1) != a.substr(j)) break;
+        ++len;
+    }
+    return len == limit && limit < n ? -1 : len;
+}
+
+// Suffix array of a·b from the suffix arrays of a and b, without sorting
+// the suffixes of b again.
+//
+// Suffixes starting in b keep their order. A suffix of a·b starting in a
+// keeps its sa_a order relative to every other one unless one of the two
+// suffixes of a is a prefix of the other, and then the order follows from
+// whether the longer one's continuation past that prefix is greater than b.
+// merge_gaps ranks every such suffix among those of b by backward search,
+// which gives both that test and the final interleaving.
+//
+// When a ends in a long repeat, too many suffixes need that fix-up, and the
+// suffixes of a are instead sorted by sa_is over a with each character tagged
+// by the test bit of the suffix after it.
+template<class SA_A, class SA_B>
+std::vector<int> merge_suffix_arrays(std::wstring_view a, const SA_A &sa_a, std::wstring_view b, const SA_B &sa_b) {
+    constexpr int max_repeat = 4096;
+    int na = a.size(), nb = b.size();
+    auto gap = merge_gaps(a, b, sa_b);
+    int rank_b = gap[na];
+    auto greater_than_b = [&](int k) {
+        return gap[k] > rank_b;
+    };
+    std::vector<int> order;
+    order.reserve(na);
+    int len = repeated_suffix(a, sa_a, max_repeat);
+    if(len == -1) {
+        // A suffix ending first must sort after the others it ties with, so
+        // sort the complemented text and read the result backwards.
+        std::vector<int> s(na);
+        for(int k = 0; k < na; ++k) {
+            s[k] = 131071 - (2 * (int)(unsigned)a[k] + greater_than_b(k + 1));
+        }
+        order = sa_is(s, 131071);
+        std::reverse(order.begin(), order.end());
+    } else {
+        auto less = [&](int i, int j) {
+            if(i == j) return false;
+            int m = std::min(na - i, na - j);
+            int d = std::mismatch(a.begin() + i, a.begin() + i + m, a.begin() + j).first - (a.begin() + i);
+            if(d < m) return a[i + d] < a[j + d];
+            return i < j ? !greater_than_b(i + m) : greater_than_b(j + m);
+        };
+        std::vector<int> tail(len);
+        std::iota(tail.begin(), tail.end(), na - len);
+        std::sort(tail.begin(), tail.end(), less);
+        auto it = tail.begin();
+        for(int k = 0; k < na; ++k) {
+            int i = sa_a[k];
+            if(i >= na - len) continue;
+            for(; it != tail.end() && less(*it, i); ++it) {
+                order.push_back(*it);
+            }
+            order.push_back(i);
+        }
+        order.insert(order.end(), it, tail.end());
+    }
+    std::vector<int> sa;
+    sa.reserve(na + nb);
+    int k = 0;
+    for(int i : order) {
+        for(; k < gap[i] - 1; ++k) {
+            sa.push_back(sa_b[k] + na);
+        }
+        sa.push_back(i);
+    }
+    for(; k < nb; ++k) {
+        sa.push_back(sa_b[k] + na);
+    }
+    return sa;
+}
+
+} // namespace detail
+
+} // namespace sa_ps
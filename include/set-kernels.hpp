@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+// Without -mssse3 the SSSE3 kernel is still compiled on x86, for that one
+// function, and picked at run time when the CPU supports it.
+#if defined(__SSSE3__)
+#define SA_PS_SSSE3
+#define SA_PS_SSSE3_TARGET
+#include <tmmintrin.h>
+#elif(defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SA_PS_SSSE3
+#define SA_PS_SSSE3_DISPATCH
+#define SA_PS_SSSE3_TARGET __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#endif
+
+namespace sa_ps {
+
+namespace detail {
+
+// Merge kernels over strictly increasing position lists. The window variants
+// implement the pairing used by grouped_match: two hits at most `md` apart are
+// consumed together and yield the smaller one; with md = 0 they reduce to
+// plain intersection and union.
+namespace scalar {
+
+// First index >= from whose value is >= target, by exponential search.
+std::size_t gallop(std::span<const int> v, std::size_t from, int target) {
+    std::size_t step = 1, hi = from;
+    while(hi < v.size() && v[hi] < target) {
+        from = hi + 1;
+        hi += step;
+        step <<= 1;
+    }
+    return std::lower_bound(v.begin() + from, v.begin() + std::min(hi, v.size()), target) - v.begin();
+}
+
+// Sizes this far apart make the per-element loop mostly predictable skips,
+// so the long side is galloped over instead.
+bool skewed(std::span<const int> a, std::span<const int> b) {
+    return std::min(a.size(), b.size()) * 8 < std::max(a.size(), b.size());
+}
+
+template<bool Union>
+std::vector<int> window_merge_skewed(std::span<const int> a, std::span<const int> b, int md) {
+    std::vector<int> ans;
+    if(Union) ans.reserve(a.size() + b.size());
+    bool swapped = a.size() > b.size();
+    std::span<const int> small = swapped ? b : a, big = swapped ? a : b;
+    std::size_t j = 0, k = 0;
+    while(j < small.size() && k < big.size()) {
+        std::size_t next = gallop(big, k, small[j] - md);
+        if(Union) ans.insert(ans.end(), big.begin() + k, big.begin() + next);
+        k = next;
+        if(k == big.size()) break;
+        if(big[k] - small[j] <= md) {
+            ans.push_back(std::min(small[j], big[k]));
+            ++k;
+        } else if(Union) {
+            ans.push_back(small[j]);
+        }
+        ++j;
+    }
+    if(Union) {
+        ans.insert(ans.end(), small.begin() + j, small.end());
+        ans.insert(ans.end(), big.begin() + k, big.end());
+    }
+    return ans;
+}
+
+// Branchless: the pair test and both pointer advances are computed as flags.
+template<bool Union>
+std::vector<int> window_merge(std::span<const int> a, std::span<const int> b, int md) {
+    if(skewed(a, b)) return window_merge_skewed<Union>(a, b, md);
+    std::vector<int> ans(Union ? a.size() + b.size() : std::min(a.size(), b.size()));
+    int *out = ans.data();
+    std::size_t j = 0, k = 0, o = 0;
+    while(j < a.size() && k < b.size()) {
+        int x = a[j], y = b[k];
+        bool pair = (uint64_t)((int64_t)x - y + md) <= 2 * (uint64_t)md;
+        bool lt = x < y;
+        out[o] = std::min(x, y);
+        o += Union || pair;
+        j += pair | lt;
+        k += pair | !lt;
+    }
+    if(Union) {
+        o = std::copy(a.begin() + j, a.end(), out + o) - out;
+        o = std::copy(b.begin() + k, b.end(), out + o) - out;
+    }
+    ans.resize(o);
+    return ans;
+}
+
+std::vector<int> window_and(std::span<const int> a, std::span<const int> b, int md) {
+    return window_merge<false>(a, b, md);
+}
+std::vector<int> window_or(std::span<const int> a, std::span<const int> b, int md) {
+    return window_merge<true>(a, b, md);
+}
+std::vector<int> sorted_intersect(std::span<const int> a, std::span<const int> b) {
+    return window_and(a, b, 0);
+}
+std::vector<int> sorted_union(std::span<const int> a, std::span<const int> b) {
+    return window_or(a, b, 0);
+}
+
+} // namespace scalar
+
+#if defined(SA_PS_SSSE3)
+namespace simd {
+
+struct shuffle_table {
+    alignas(16) uint8_t masks[16][16];
+    constexpr shuffle_table() : masks() {
+        for(int m = 0; m < 16; ++m) {
+            int out = 0;
+            for(int lane = 0; lane < 4; ++lane) {
+                if(m >> lane & 1) {
+                    for(int byte = 0; byte < 4; ++byte) masks[m][out * 4 + byte] = lane * 4 + byte;
+                    ++out;
+                }
+            }
+            for(int i = out * 4; i < 16; ++i) masks[m][i] = 0x80;
+        }
+    }
+};
+constexpr shuffle_table left_pack;
+
+// Lemire, Boytsov and Kurz: compare a block of 4 from each side against all
+// rotations of the other, then pack the matching lanes with one shuffle.
+SA_PS_SSSE3_TARGET std::vector<int> sorted_intersect(std::span<const int> a, std::span<const int> b) {
+    if(scalar::skewed(a, b)) return scalar::window_merge_skewed<false>(a, b, 0);
+    std::vector<int> ans(std::min(a.size(), b.size()) + 4);
+    int *out = ans.data();
+    std::size_t j = 0, k = 0;
+    while(j + 4 <= a.size() && k + 4 <= b.size()) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a.data() + j));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b.data() + k));
+        __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(va, _mm_load_si128((const __m128i *)left_pack.masks[mask])));
+        out += std::popcount((unsigned)mask);
+        int amax = a[j + 3], bmax = b[k + 3];
+        j += (amax <= bmax) * 4;
+        k += (bmax <= amax) * 4;
+    }
+    auto tail = scalar::sorted_intersect(a.subspan(j), b.subspan(k));
+    out = std::copy(tail.begin(), tail.end(), out);
+    ans.resize(out - ans.data());
+    return ans;
+}
+
+} // namespace simd
+#endif
+
+// Whether sorted_intersect uses the SSSE3 kernel on this CPU.
+bool ssse3_intersect() {
+#if defined(SA_PS_SSSE3_DISPATCH)
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+    return ssse3;
+#elif defined(SA_PS_SSSE3)
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<int> sorted_intersect(std::span<const int> a, std::span<const int> b) {
+#if defined(SA_PS_SSSE3)
+    if(ssse3_intersect()) return simd::sorted_intersect(a, b);
+#endif
+    return scalar::sorted_intersect(a, b);
+}
+std::vector<int> sorted_union(std::span<const int> a, std::span<const int> b) {
+    return scalar::sorted_union(a, b);
+}
+std::vector<int> window_and(std::span<const int> a, std::span<const int> b, int md) {
+    if(md == 0) return sorted_intersect(a, b);
+    return scalar::window_and(a, b, md);
+}
+std::vector<int> window_or(std::span<const int> a, std::span<const int> b, int md) {
+    return scalar::window_or(a, b, md);
+}
+
+} // namespace detail
+
+} // namespace sa_ps
+
+#undef SA_PS_SSSE3
+#undef SA_PS_SSSE3_DISPATCH
+#undef SA_PS_SSSE3_TARGET
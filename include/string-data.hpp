@@ -3,24 +3,453 @@
 #include "sa-is.hpp"
 #include "sa-match.hpp"
 #include "grouped-data.hpp"
+#include "index-file.hpp"
+#include "sa-merge.hpp"
+#include "explain.hpp"
+#include "npy-export.hpp"
 #include <vector>
 #include <string>
+#include <string_view>
+#include <span>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <type_traits>
+#include <tuple>
+#include <cstdio>
+#include <unistd.h>
 
 namespace sa_ps {
 
 class string_data {
 public:
-    explicit string_data(const std::wstring &str) : m_str(str), sa(detail::suffix_array(str)) {}
+    explicit string_data(const std::wstring &str) : string_data(str, build_options()) {}
+    string_data(const std::wstring &str, const build_options &options) {
+        detail::build_context ctx(options);
+        finish(build(str, ctx), options, ctx);
+    }
+
+    // Attaches to an index written by save() through a read-only shared file
+    // mapping; processes mapping the same file share one physical copy.
+    // Only the header and lookup tables are checked by default, so opening
+    // does not read the whole mapping; with verify, every section is also
+    // checked against its header checksum.
+    static string_data open(const std::string &path, bool verify = false) {
+        auto m = detail::map_file(path);
+        return string_data(detail::read_index(m->data(), m->size(), verify), m);
+    }
+    // Same, for a POSIX shared-memory object created by publish().
+    static string_data attach(const std::string &shm_name, bool verify = false) {
+        auto m = detail::map_shm(shm_name);
+        return string_data(detail::read_index(m->data(), m->size(), verify), m);
+    }
+    // Writes a temporary file next to path and renames it over path, so
+    // processes that still map an older index at path keep a complete copy.
+    void save(const std::string &path) const {
+        std::string tmp = path + ".tmp." + std::to_string(getpid());
+        std::ofstream out(tmp, std::ios::binary);
+        detail::write_index(detail::layout_index(view()), [&](const char *p, uint64_t n) {
+            out.write(p, n);
+        });
+        out.close();
+        if(!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+    void publish(const std::string &shm_name) const {
+        detail::publish_shm(shm_name, detail::layout_index(view()));
+    }
+    static void unpublish(const std::string &shm_name) {
+        shm_unlink(shm_name.c_str());
+    }
+    // Writes the SA, unpacked if need be, or the LCP array as .npy files
+    // (see npy-export.hpp).
+    void export_sa(const std::string &path) const {
+        write_npy(path, m_str.size(), [&](int32_t *out) {
+            with_sa([&](const auto &sa) {
+                for(std::size_t i = 0; i < m_str.size(); ++i) {
+                    out[i] = sa[i];
+                }
+                return 0;
+            });
+        });
+    }
+    void export_lcp(const std::string &path) const {
+        write_npy(path, m_str.size(), [&](int32_t *out) {
+            with_sa([&](const auto &sa) {
+                detail::lcp_array(m_str, sa, out);
+                return 0;
+            });
+        });
+    }
+    // Checks in the background that the SA and C array really belong to the
+    // text, catching an index saved from the wrong text or a buggy build that
+    // checksums cannot. The result keeps the index storage alive.
+    std::future<bool> validate() const {
+        return std::async(std::launch::async, [storage = m_storage, s = m_str, sa = sa, packed = m_packed_sa, c = m_c] {
+            return packed.width ? detail::validate_suffix_array(s, packed, c) : detail::validate_suffix_array(s, sa, c);
+        });
+    }
+
+    // Index of front's text followed by back's, with the suffix array merged
+    // from theirs by merge_suffix_arrays instead of being rebuilt.
+    static string_data merge(const string_data &front, const string_data &back, const build_options &options = {}) {
+        auto a = std::make_shared<arrays>();
+        a->str.reserve(front.m_str.size() + back.m_str.size());
+        a->str.append(front.m_str).append(back.m_str);
+        a->sa = front.with_sa([&](const auto &sa_a) {
+            return back.with_sa([&](const auto &sa_b) {
+                return detail::merge_suffix_arrays(front.m_str, sa_a, back.m_str, sa_b);
+            });
+        });
+        a->c.resize(front.m_c.size());
+        for(int i = 0; i < a->c.size(); ++i) {
+            a->c[i] = front.m_c[i] + back.m_c[i];
+        }
+        return string_data(std::move(a), options);
+    }
+
     std::vector<int> search(const std::wstring &pattern) const {
-        return detail::sa_match(m_str, sa, pattern);
+        if(auto hot = find_hot(pattern)) {
+            auto list = m_hot_pos.subspan(hot->offset, hot->size);
+            return std::vector<int>(list.begin(), list.end());
+        }
+        return with_sa([&](const auto &sa) {
+            if(pattern.empty() || pattern.size() >= m_str.size()) return detail::sa_match(m_str, sa, pattern);
+            auto [l, r] = locate_interval(pattern);
+            std::vector<int> ans(r - l);
+            for(int i = l; i < r; ++i) {
+                ans[i - l] = sa[i];
+            }
+            std::sort(ans.begin(), ans.end());
+            return ans;
+        });
     }
     template<detail::group_type Type>
     std::vector<int> search(const detail::grouped_data<Type> &data, int max_distance = 5) const {
-        return detail::grouped_match(m_str, sa, data, max_distance);
+        if constexpr(Type == detail::group_type::OR) {
+            if(data.strs.size() >= detail::scan_min_terms) {
+                unsigned threads = std::thread::hardware_concurrency();
+                long long hits = 0;
+                for(auto &t : data.strs) hits += count(t);
+                if(detail::prefer_scan(m_str.size(), data.strs.size(), hits, threads)) {
+                    return detail::or_merge(detail::scan_lists(m_str, data.strs, threads), max_distance);
+                }
+            }
+        }
+        return detail::grouped_match_with(m_str.size(), data, max_distance, [&](const std::wstring &pattern) {
+            return search(pattern);
+        });
+    }
+    // search() under per-query limits: the hot list or SA interval size is
+    // checked before anything is copied, see detail::match_limits.
+    detail::limited_hits search(const std::wstring &pattern, const detail::match_limits &limits) const {
+        if(auto hot = find_hot(pattern)) {
+            detail::limited_hits ans;
+            ans.total = hot->size;
+            if(ans.total > limits.cap()) {
+                ans.status = limits.truncate ? detail::match_status::truncated : detail::match_status::too_many;
+                if(!limits.truncate) return ans;
+            }
+            auto list = m_hot_pos.subspan(hot->offset, std::min(ans.total, limits.cap()));
+            ans.hits.assign(list.begin(), list.end());
+            return ans;
+        }
+        return with_sa([&](const auto &sa) {
+            if(pattern.empty() || pattern.size() >= m_str.size()) return detail::sa_match(m_str, sa, pattern, limits);
+            auto [l, r] = locate_interval(pattern);
+            return detail::limited_interval(sa, l, r, limits);
+        });
+    }
+    template<detail::group_type Type>
+    detail::limited_hits search(const detail::grouped_data<Type> &data, int max_distance, const detail::match_limits &limits) const {
+        auto count = [&](const std::wstring &pattern) -> std::size_t {
+            return this->count(pattern);
+        };
+        auto match = [&](const std::wstring &pattern, const detail::match_limits &term_limits) {
+            return search(pattern, term_limits);
+        };
+        return detail::grouped_match_with(m_str.size(), data, max_distance, limits, count, match);
+    }
+    // Runs the query the way search() does and records what each step did.
+    explain_node explain_analyze(const std::wstring &pattern) const {
+        std::vector<int> hits;
+        return explain_term(pattern, hits);
+    }
+    template<detail::group_type Type>
+    explain_node explain_analyze(const detail::grouped_data<Type> &data, int max_distance = 5) const {
+        auto start = std::chrono::steady_clock::now();
+        explain_node root;
+        root.op = Type == detail::group_type::AND ? "and" : "or";
+        root.method = "max_distance=" + std::to_string(max_distance);
+        std::vector<std::vector<int>> lists;
+        bool scanned = false;
+        if constexpr(Type == detail::group_type::OR) {
+            if(data.strs.size() >= detail::scan_min_terms) {
+                unsigned threads = std::thread::hardware_concurrency();
+                long long hits = 0;
+                for(auto &t : data.strs) hits += count(t);
+                if(detail::prefer_scan(m_str.size(), data.strs.size(), hits, threads)) {
+                    auto scan_start = std::chrono::steady_clock::now();
+                    lists = detail::scan_lists(m_str, data.strs, threads);
+                    explain_node scan;
+                    scan.op = "scan";
+                    scan.method = "aho_corasick";
+                    scan.input_sizes = {(long long)m_str.size()};
+                    scan.output_size = hits;
+                    scan.total_ms = detail::elapsed_ms(scan_start);
+                    root.children.push_back(std::move(scan));
+                    scanned = true;
+                }
+            }
+        }
+        if(!scanned) {
+            for(auto &t : data.strs) {
+                lists.emplace_back();
+                root.children.push_back(explain_term(t, lists.back()));
+            }
+        }
+        auto merge_start = std::chrono::steady_clock::now();
+        explain_node merge;
+        merge.op = "merge";
+        std::vector<int> ans;
+        if(lists.empty()) {
+            merge.method = "all_positions";
+            ans.resize(m_str.size());
+            std::iota(ans.begin(), ans.end(), 0);
+        } else if constexpr(Type == detail::group_type::AND) {
+            merge.method = max_distance == 0 ? "intersect" : "cooccurrence";
+            ans = detail::window_starts(detail::cooccurrence(std::vector<std::span<const int>>(lists.begin(), lists.end()), max_distance));
+        } else {
+            merge.method = max_distance == 0 && lists.size() > 2 ? "bitmap_union" : "window_union";
+            ans = detail::or_merge(lists, max_distance);
+        }
+        for(auto &list : lists) merge.input_sizes.push_back(list.size());
+        merge.output_size = ans.size();
+        merge.total_ms = detail::elapsed_ms(merge_start);
+        root.children.push_back(std::move(merge));
+        root.output_size = ans.size();
+        root.total_ms = detail::elapsed_ms(start);
+        return root;
+    }
+
+    std::vector<int> search(const detail::grouped_data<detail::group_type::AND> &data, int max_distance, unsigned threads) const {
+        return detail::window_starts(windows(data, max_distance, threads));
+    }
+    // Term lists come from search(pattern), so hot lists and the char and
+    // bigram tables serve them as in the serial search.
+    std::vector<detail::match_window> windows(const detail::grouped_data<detail::group_type::AND> &data, int max_distance = 5, unsigned threads = 1) const {
+        if(data.strs.empty()) {
+            std::vector<detail::match_window> ans(m_str.size());
+            for(int i = 0; i < ans.size(); ++i) {
+                ans[i] = {i, i};
+            }
+            return ans;
+        }
+        std::vector<std::vector<int>> fevery(data.strs.size());
+        for(int i = 0; i < fevery.size(); ++i) {
+            fevery[i] = search(data.strs[i]);
+        }
+        return detail::cooccurrence(std::vector<std::span<const int>>(fevery.begin(), fevery.end()), max_distance, m_str.size(), threads);
+    }
+    // The C array covers the BMP only, which is all the text can hold.
+    int count(wchar_t c) const {
+        if((unsigned)c >= 65536) return 0;
+        return m_c[(unsigned)c + 1] - m_c[(unsigned)c];
+    }
+    int count(const std::wstring &pattern) const {
+        if(pattern.size() == 1) return count(pattern[0]);
+        if(m_str.size() <= pattern.size()) return m_str == pattern;
+        auto [l, r] = locate_interval(pattern);
+        return r - l;
+    }
+    // Half-open SA interval of the suffixes starting with pattern. One- and
+    // two-character patterns are table lookups; longer ones binary-search
+    // only inside their leading bigram's interval.
+    std::pair<int, int> locate_interval(const std::wstring &pattern) const {
+        if(pattern.empty()) return {0, (int)m_str.size()};
+        if(pattern.size() == 1) {
+            if((unsigned)pattern[0] >= 65536) return {0, 0};
+            return {m_c[(unsigned)pattern[0]], m_c[(unsigned)pattern[0] + 1]};
+        }
+        auto [l, r] = detail::bigram_lookup(m_bigrams, pattern[0], pattern[1]);
+        if(pattern.size() == 2 || l == r) return {l, r};
+        return with_sa([&](const auto &sa) {
+            return detail::sa_interval(m_str, sa, pattern, l, r);
+        });
+    }
+    // Text position of the i-th smallest suffix.
+    int suffix(int i) const {
+        return with_sa([&](const auto &sa) {
+            return (int)sa[i];
+        });
+    }
+    std::wstring_view text() const {
+        return m_str;
+    }
+    // Bytes held by the SA itself, packed or not.
+    std::size_t sa_bytes() const {
+        return m_packed_sa.width ? m_packed_sa.bytes().size() : sa.size_bytes();
     }
 private:
-    std::wstring m_str;
-    std::vector<int> sa;
+    struct arrays {
+        std::wstring str;
+        std::vector<int> sa, c, hot_pos;
+        std::vector<uint64_t> packed_sa;
+        std::vector<detail::bigram_interval> bigrams;
+        std::vector<detail::hot_list> hot;
+    };
+
+    string_data(std::shared_ptr<arrays> a, const build_options &options) {
+        detail::build_context ctx(options);
+        finish(std::move(a), options, ctx);
+    }
+    string_data(const detail::index_view &v, std::shared_ptr<const void> storage) : m_storage(std::move(storage)) {
+        set_view(v);
+    }
+
+    // The stages after the SA each take a pass over it, so a cancelled or
+    // over-budget build stops between them too.
+    void finish(std::shared_ptr<arrays> a, const build_options &options, detail::build_context &ctx) {
+        ctx.check();
+        keep_hot_chars(*a, options.hot_chars);
+        ctx.check();
+        a->bigrams = detail::bigram_table(a->str, a->sa);
+        detail::packed_span packed;
+        if(options.pack_sa) {
+            ctx.check();
+            packed.width = detail::packed_width(a->sa.size());
+            packed.count = a->sa.size();
+            a->packed_sa = detail::pack(a->sa, packed.width);
+            packed.data = (const char *)a->packed_sa.data();
+            a->sa = {};
+        }
+        set_view({a->str, a->sa, a->c, packed, a->bigrams, a->hot, a->hot_pos});
+        m_storage = a;
+    }
+
+    // search(pattern), step by step; hits receives its result.
+    explain_node explain_term(const std::wstring &pattern, std::vector<int> &hits) const {
+        auto start = std::chrono::steady_clock::now();
+        explain_node node;
+        node.op = "term";
+        node.term = pattern;
+        if(auto hot = find_hot(pattern)) {
+            node.method = "hot_list";
+            node.interval = hot->size;
+            hits = search(pattern);
+        } else if(pattern.empty() || pattern.size() >= m_str.size()) {
+            node.method = "direct";
+            hits = search(pattern);
+        } else {
+            int l, r;
+            if(pattern.size() == 1) {
+                node.method = "char_table";
+                std::tie(l, r) = locate_interval(pattern);
+            } else {
+                node.method = "bigram_table";
+                std::tie(l, r) = detail::bigram_lookup(m_bigrams, pattern[0], pattern[1]);
+                if(pattern.size() > 2 && l != r) {
+                    node.method += "+binary_search";
+                    std::tie(l, r) = with_sa([&](const auto &sa) {
+                        detail::counting_sa<std::decay_t<decltype(sa)>> counted{sa};
+                        auto range = detail::sa_interval(m_str, counted, pattern, l, r);
+                        node.probes = counted.probes;
+                        return range;
+                    });
+                }
+            }
+            node.interval = r - l;
+            node.lookup_ms = detail::elapsed_ms(start);
+            auto sort_start = std::chrono::steady_clock::now();
+            hits.resize(r - l);
+            with_sa([&](const auto &sa) {
+                for(int i = l; i < r; ++i) {
+                    hits[i - l] = sa[i];
+                }
+                return 0;
+            });
+            std::sort(hits.begin(), hits.end());
+            node.sort_ms = detail::elapsed_ms(sort_start);
+        }
+        node.output_size = hits.size();
+        node.total_ms = detail::elapsed_ms(start);
+        return node;
+    }
+
+    static std::shared_ptr<arrays> build(const std::wstring &str, detail::build_context &ctx) {
+        detail::check_bmp(str);
+        auto a = std::make_shared<arrays>();
+        a->str = str;
+        a->sa = detail::suffix_array(str, ctx, &a->c);
+        return a;
+    }
+
+    // The precomputed position list of a one-character pattern, if it has one.
+    const detail::hot_list *find_hot(const std::wstring &pattern) const {
+        if(pattern.size() != 1 || m_str.size() <= 1) return nullptr;
+        auto it = std::lower_bound(m_hot.begin(), m_hot.end(), pattern[0], [](const detail::hot_list &h, wchar_t c) {
+            return h.c < c;
+        });
+        return it != m_hot.end() && it->c == pattern[0] ? &*it : nullptr;
+    }
+
+    // The SA interval of every character comes from sa_is's bucket array, so
+    // the most frequent ones can be listed in text order by one scan.
+    static void keep_hot_chars(arrays &a, int hot) {
+        std::vector<int> order(a.c.size() - 1);
+        std::iota(order.begin(), order.end(), 0);
+        hot = std::min<int>(hot, order.size());
+        std::partial_sort(order.begin(), order.begin() + hot, order.end(), [&](int x, int y) {
+            return a.c[x + 1] - a.c[x] > a.c[y + 1] - a.c[y];
+        });
+        std::sort(order.begin(), order.begin() + hot);
+        std::vector<int> slot(order.size(), -1);
+        int total = 0;
+        for(int i = 0; i < hot; ++i) {
+            int c = order[i], size = a.c[c + 1] - a.c[c];
+            if(size == 0) continue;
+            slot[c] = a.hot.size();
+            a.hot.push_back({(wchar_t)c, total, 0});
+            total += size;
+        }
+        a.hot_pos.resize(total);
+        for(int i = 0; i < a.str.size(); ++i) {
+            int h = slot[(unsigned)a.str[i]];
+            if(h != -1) a.hot_pos[a.hot[h].offset + a.hot[h].size++] = i;
+        }
+    }
+
+    detail::index_view view() const {
+        return {m_str, sa, m_c, m_packed_sa, m_bigrams, m_hot, m_hot_pos};
+    }
+    void set_view(const detail::index_view &v) {
+        m_str = v.str;
+        sa = v.sa;
+        m_c = v.c;
+        m_packed_sa = v.packed_sa;
+        m_bigrams = v.bigrams;
+        m_hot = v.hot;
+        m_hot_pos = v.hot_pos;
+    }
+
+    template<class F>
+    std::invoke_result_t<F, std::span<const int>> with_sa(F &&f) const {
+        return m_packed_sa.width ? f(m_packed_sa) : f(sa);
+    }
+
+    // The members below are views into m_storage, which is either the arrays
+    // built by the constructor or a mapping shared with other processes.
+    std::shared_ptr<const void> m_storage;
+    std::wstring_view m_str;
+    std::span<const int> sa, m_c;
+    detail::packed_span m_packed_sa;
+    std::span<const detail::bigram_interval> m_bigrams;
+    std::span<const detail::hot_list> m_hot;
+    std::span<const int> m_hot_pos;
 };
 
-} // namespace sa_ps
\ No newline at end of file
+} // namespace sa_ps
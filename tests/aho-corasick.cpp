@@ -0,0 +1,90 @@
+#include "aho-corasick.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+// Every start of pattern in text, by repeated std::wstring::find; an empty
+// pattern matches at every position, as in search().
+std::vector<int> find_all(const std::wstring &text, const std::wstring &pattern) {
+    std::vector<int> ans;
+    if(pattern.empty()) {
+        for(int i = 0; i < text.size(); ++i) ans.push_back(i);
+        return ans;
+    }
+    for(auto at = text.find(pattern); at != std::wstring::npos; at = text.find(pattern, at + 1)) ans.push_back(at);
+    return ans;
+}
+
+// Patterns that overlap themselves and each other, share prefixes and
+// suffixes, repeat, or are empty.
+std::vector<std::wstring> random_patterns(std::mt19937 &rng, int alphabet) {
+    std::vector<std::wstring> patterns;
+    int n = 1 + rng() % 20;
+    for(int i = 0; i < n; ++i) {
+        auto p = random_text(rng, 1 + rng() % 6, alphabet);
+        if(!patterns.empty() && rng() % 3 == 0) {
+            auto &q = patterns[rng() % patterns.size()];
+            switch(rng() % 4) {
+            case 0: p = q + p; break;
+            case 1: p = q.substr(0, rng() % (q.size() + 1)); break;
+            case 2: p = p + q; break;
+            default: p = q; break;
+            }
+        }
+        if(rng() % 25 == 0) p = L"";
+        patterns.push_back(p);
+    }
+    return patterns;
+}
+
+int main() {
+    std::mt19937 rng(86);
+    for(int iter = 0; iter < 200; ++iter) {
+        int alphabet = 1 + iter % 4;
+        auto text = random_text(rng, rng() % 500, alphabet);
+        if(iter % 10 == 0 && !text.empty()) text[rng() % text.size()] = (wchar_t)0x1F600;
+        auto patterns = random_patterns(rng, alphabet);
+        if(iter % 10 == 0) patterns.push_back(std::wstring(1, (wchar_t)0x1F600) + L"a");
+        if(iter % 10 == 0) patterns.push_back(std::wstring(1, (wchar_t)0x1F600));
+        auto lists = detail::scan_lists(text, patterns, 1 + iter % 4);
+        CHECK(lists.size() == patterns.size());
+        for(int i = 0; i < patterns.size(); ++i) {
+            CHECK(lists[i] == find_all(text, patterns[i]));
+        }
+
+        // A scan of [begin, end) reports exactly the starts in it, in order
+        // of end position.
+        std::vector<std::wstring> nonempty;
+        for(auto &p : patterns) {
+            if(!p.empty()) nonempty.push_back(p);
+        }
+        if(nonempty.empty()) continue;
+        detail::aho_corasick ac(nonempty);
+        int begin = rng() % (text.size() + 1), end = begin + rng() % (text.size() + 1 - begin);
+        std::vector<std::pair<int, int>> seen, expected;
+        ac.scan(text, begin, end, [&](int start, int term) { seen.push_back({start + (int)nonempty[term].size(), term}); });
+        for(int t = 0; t < nonempty.size(); ++t) {
+            for(int x : find_all(text, nonempty[t])) {
+                if(x >= begin && x < end) expected.push_back({x + (int)nonempty[t].size(), t});
+            }
+        }
+        CHECK(std::is_sorted(seen.begin(), seen.end(), [](auto &a, auto &b) { return a.first < b.first; }));
+        std::sort(seen.begin(), seen.end());
+        std::sort(expected.begin(), expected.end());
+        CHECK(seen == expected);
+    }
+    // Texts long enough to be scanned in several chunks, with matches
+    // straddling the chunk boundaries.
+    for(int iter = 0; iter < 4; ++iter) {
+        auto text = random_text(rng, 300000, 2);
+        auto patterns = random_patterns(rng, 2);
+        patterns.push_back(std::wstring(12, L'a'));
+        for(unsigned threads : {2u, 3u, 5u}) {
+            auto lists = detail::scan_lists(text, patterns, threads);
+            for(int i = 0; i < patterns.size(); ++i) {
+                CHECK(lists[i] == find_all(text, patterns[i]));
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "batch-executor.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+int main() {
+    std::mt19937 rng(98);
+    // Large enough that AND merges over frequent terms are partitioned.
+    auto text = random_text(rng, 100000, 3);
+    string_data data(text);
+    batch_executor executor(data, 4);
+    auto sample = [&](int len) {
+        return text.substr(rng() % (text.size() - len), len);
+    };
+    std::vector<batch_executor::query> queries;
+    queries.push_back(std::wstring(L"a") & std::wstring(L"zz"));
+    queries.push_back(std::wstring(L"a") & std::wstring(L"b"));
+    for(int i = 0; i < 120; ++i) {
+        switch(i % 3) {
+        case 0:
+            queries.push_back(sample(1 + rng() % 5));
+            break;
+        case 1: {
+            detail::grouped_data<detail::group_type::AND> q;
+            for(int k = 1 + rng() % 3; k > 0; --k) q.strs.push_back(sample(1 + rng() % 3));
+            queries.push_back(q);
+            break;
+        }
+        default: {
+            detail::grouped_data<detail::group_type::OR> q;
+            for(int k = i % 15 == 2 ? 20 : 1 + rng() % 4; k > 0; --k) q.strs.push_back(sample(2 + rng() % 3));
+            queries.push_back(q);
+        }
+        }
+    }
+    for(int md : {0, 4}) {
+        auto results = executor.run(queries, md);
+        CHECK(results.size() == queries.size());
+        for(std::size_t i = 0; i < queries.size(); ++i) {
+            auto expected = std::visit([&](const auto &q) {
+                if constexpr(std::is_same_v<std::decay_t<decltype(q)>, std::wstring>) {
+                    return data.search(q);
+                } else {
+                    return data.search(q, md);
+                }
+            }, queries[i]);
+            CHECK(results[i] == expected);
+        }
+    }
+    // Small batches reuse the same pool.
+    for(int i = 0; i < 20; ++i) {
+        CHECK(executor.run({queries[i]}, 2).size() == 1);
+    }
+    return 0;
+}
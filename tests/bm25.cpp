@@ -0,0 +1,72 @@
+#include "collection.hpp"
+#include "check.hpp"
+#include <cmath>
+
+using namespace sa_ps;
+
+// BM25 of every live document from direct counts, best first.
+std::vector<ranked_doc> brute_rank(const std::vector<std::wstring> &docs, const std::vector<bool> &dead, const std::vector<std::wstring> &terms, const bm25_params &p) {
+    int live = 0;
+    double total = 0;
+    for(int id = 0; id < docs.size(); ++id) {
+        if(!dead[id]) ++live, total += docs[id].size();
+    }
+    std::vector<ranked_doc> ans;
+    if(live == 0) return ans;
+    std::vector<double> score(docs.size());
+    std::vector<bool> hit(docs.size());
+    for(auto &t : terms) {
+        int df = 0;
+        for(int id = 0; id < docs.size(); ++id) df += !dead[id] && !brute_find(docs[id], t).empty();
+        if(df == 0) continue;
+        double idf = std::log(1 + (live - df + 0.5) / (df + 0.5));
+        for(int id = 0; id < docs.size(); ++id) {
+            int tf = dead[id] ? 0 : brute_find(docs[id], t).size();
+            if(tf == 0) continue;
+            hit[id] = true;
+            score[id] += idf * tf * (p.k1 + 1) / (tf + p.k1 * (1 - p.b + p.b * docs[id].size() / (total / live)));
+        }
+    }
+    for(int id = 0; id < docs.size(); ++id) {
+        if(hit[id]) ans.push_back({id, score[id]});
+    }
+    std::stable_sort(ans.begin(), ans.end(), [](const ranked_doc &x, const ranked_doc &y) {
+        return x.score > y.score;
+    });
+    return ans;
+}
+
+int main() {
+    std::mt19937 rng(100);
+    for(int iter = 0; iter < 60; ++iter) {
+        int alphabet = 2 + iter % 4;
+        std::vector<std::wstring> docs(1 + rng() % 40);
+        for(auto &d : docs) d = random_text(rng, rng() % 60, alphabet);
+        collection c(docs, 0.9);
+        std::vector<bool> dead(docs.size());
+        for(int q = 0; q < 30; ++q) {
+            if(rng() % 5 == 0) {
+                int id = rng() % docs.size();
+                c.remove(id);
+                dead[id] = true;
+            }
+            std::vector<std::wstring> terms;
+            for(int k = 1 + rng() % 4; k > 0; --k) terms.push_back(random_text(rng, 1 + rng() % 3, alphabet + 1));
+            int k = 1 + rng() % 8;
+            bm25_params params;
+            params.b = q % 2 ? 0.75 : 0.3;
+            auto expected = brute_rank(docs, dead, terms, params);
+            std::vector<double> score(docs.size(), -1);
+            for(auto &d : expected) score[d.id] = d.score;
+            if(expected.size() > k) expected.resize(k);
+            auto got = c.rank(terms, k, params);
+            CHECK(got.size() == expected.size());
+            // Ties may legitimately order differently; scores must match rank by rank.
+            for(std::size_t i = 0; i < got.size(); ++i) {
+                CHECK(std::abs(got[i].score - expected[i].score) < 1e-9);
+                CHECK(std::abs(got[i].score - score[got[i].id]) < 1e-9);
+            }
+        }
+    }
+    return 0;
+}
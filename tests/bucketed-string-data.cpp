@@ -0,0 +1,47 @@
+#include "bucketed-string-data.hpp"
+#include "string-data.hpp"
+#include "check.hpp"
+#include <stdexcept>
+
+using namespace sa_ps;
+
+int main() {
+    std::mt19937 rng(83);
+    for(int iter = 0; iter < 40; ++iter) {
+        int alphabet = 1 + iter % 5;
+        auto text = random_text(rng, 1 + rng() % 300, alphabet);
+        bucketed_string_data data(text, iter % 2);
+        for(int q = 0; q < 50; ++q) {
+            auto pattern = random_text(rng, 1 + rng() % 4, alphabet + 1);
+            CHECK(data.search(pattern) == brute_find(text, pattern));
+        }
+        data.wait();
+        CHECK(data.search(L"").size() == text.size());
+        string_data reference(text);
+        auto a = random_text(rng, 1 + rng() % 2, alphabet), b = random_text(rng, 1 + rng() % 2, alphabet);
+        CHECK(data.search(a & b, 3) == reference.search(a & b, 3));
+        CHECK(data.search(a | b, 3) == reference.search(a | b, 3));
+    }
+    // A first character above U+FFFF has no bucket; text holding one is
+    // rejected like string_data rejects it.
+    bucketed_string_data data(L"abcab");
+    CHECK(data.search(std::wstring(1, (wchar_t)0x1F600)).empty());
+    CHECK(data.search(std::wstring{(wchar_t)0x1F600, L'a'}).empty());
+    std::wstring high = L"ab";
+    high += (wchar_t)0x1F600;
+    bool threw = false;
+    try {
+        bucketed_string_data bad(high);
+    } catch(const std::invalid_argument &) {
+        threw = true;
+    }
+    CHECK(threw);
+    threw = false;
+    try {
+        string_data bad(high);
+    } catch(const std::invalid_argument &) {
+        threw = true;
+    }
+    CHECK(threw);
+    return 0;
+}
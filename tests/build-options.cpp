@@ -0,0 +1,81 @@
+#include "string-data.hpp"
+#include "check.hpp"
+#include <map>
+#include <thread>
+
+using namespace sa_ps;
+
+// The message of the build_cancelled that building text with options throws,
+// or "" if the build completes.
+std::string build_error(const std::wstring &text, const build_options &options) {
+    try {
+        string_data data(text, options);
+        return "";
+    } catch(const build_cancelled &e) {
+        return e.what();
+    }
+}
+
+int main() {
+    std::mt19937 rng(81);
+    auto text = random_text(rng, 1 << 19, 3);
+
+    // Within each phase of each recursion level progress never goes back or
+    // leaves [0, 1], and the last report is completion.
+    std::vector<build_progress> reports;
+    build_options options;
+    options.progress = [&](const build_progress &p) { reports.push_back(p); };
+    string_data data(text, options);
+    CHECK(reports.size() > 8);
+    std::map<std::pair<build_phase, int>, double> last;
+    for(auto &p : reports) {
+        CHECK(p.fraction >= 0 && p.fraction <= 1);
+        auto key = std::make_pair(p.phase, p.level);
+        CHECK(!last.count(key) || last[key] <= p.fraction);
+        last[key] = p.fraction;
+    }
+    for(auto phase : {build_phase::classify, build_phase::induce_lms, build_phase::rename, build_phase::induce}) {
+        CHECK(last.count({phase, 0}));
+    }
+    CHECK(reports.back().phase == build_phase::induce && reports.back().level == 0 && reports.back().fraction == 1.0);
+    auto pattern = text.substr(1000, 5);
+    CHECK(data.search(pattern) == brute_find(text, pattern));
+
+    // Cancelling mid-build stops it at the next check.
+    std::stop_source stop;
+    int after_stop = 0;
+    options.cancel = stop.get_token();
+    options.progress = [&](const build_progress &p) {
+        if(stop.stop_requested()) ++after_stop;
+        if(p.phase == build_phase::induce_lms) stop.request_stop();
+    };
+    CHECK(build_error(text, options) == "suffix array build cancelled");
+    CHECK(after_stop == 0);
+
+    // Cancelling once the SA is complete still stops the build before the
+    // hot lists, bigram table and packing are built.
+    for(bool pack : {false, true}) {
+        std::stop_source late;
+        options.cancel = late.get_token();
+        options.pack_sa = pack;
+        options.progress = [&](const build_progress &p) {
+            if(p.phase == build_phase::induce && p.level == 0 && p.fraction == 1.0) late.request_stop();
+        };
+        CHECK(build_error(text, options) == "suffix array build cancelled");
+    }
+
+    // The time budget covers the same stages.
+    options = {};
+    options.time_budget = std::chrono::nanoseconds(1);
+    CHECK(build_error(text, options) == "suffix array build exceeded its time budget");
+    options.time_budget = std::chrono::milliseconds(300);
+    std::wstring small = random_text(rng, 1000, 3);
+    options.progress = [&](const build_progress &p) {
+        if(p.phase == build_phase::induce && p.level == 0 && p.fraction == 1.0) std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    };
+    CHECK(build_error(small, options) == "suffix array build exceeded its time budget");
+    options.time_budget = std::chrono::seconds(60);
+    options.progress = nullptr;
+    CHECK(build_error(small, options) == "");
+    return 0;
+}
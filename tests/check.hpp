@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+// Reports the failed expression and exits, so ctest shows where a check broke.
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if(!(cond)) {                                                                \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            std::exit(1);                                                            \
+        }                                                                            \
+    } while(0)
+
+// Every start of pattern in text, in increasing order.
+std::vector<int> brute_find(std::wstring_view text, std::wstring_view pattern) {
+    std::vector<int> ans;
+    for(std::size_t i = 0; i + pattern.size() <= text.size(); ++i) {
+        if(text.substr(i, pattern.size()) == pattern) ans.push_back(i);
+    }
+    return ans;
+}
+
+// Suffix array by sorting the suffixes directly.
+std::vector<int> brute_suffix_array(std::wstring_view text) {
+    std::vector<int> sa(text.size());
+    for(int i = 0; i < sa.size(); ++i) sa[i] = i;
+    std::sort(sa.begin(), sa.end(), [&](int x, int y) {
+        return text.substr(x) < text.substr(y);
+    });
+    return sa;
+}
+
+// Small alphabets make repeats, and so long common prefixes, likely.
+std::wstring random_text(std::mt19937 &rng, int size, int alphabet) {
+    std::wstring s;
+    for(int i = 0; i < size; ++i) s += L'a' + rng() % alphabet;
+    return s;
+}
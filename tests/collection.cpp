@@ -0,0 +1,76 @@
+#include "collection.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+// The pairing of or_merge, one pair of lists at a time, written out plainly.
+std::vector<int> brute_window_or(const std::vector<int> &a, const std::vector<int> &b, int md) {
+    std::vector<int> ans;
+    std::size_t j = 0, k = 0;
+    while(j < a.size() && k < b.size()) {
+        if(std::abs(a[j] - b[k]) <= md) {
+            ans.push_back(std::min(a[j++], b[k++]));
+        } else if(a[j] < b[k]) {
+            ans.push_back(a[j++]);
+        } else {
+            ans.push_back(b[k++]);
+        }
+    }
+    ans.insert(ans.end(), a.begin() + j, a.end());
+    ans.insert(ans.end(), b.begin() + k, b.end());
+    return ans;
+}
+
+// Hits as (document, offset) pairs, which survive compaction unchanged.
+std::vector<std::pair<int, int>> located(const collection &c, const std::vector<int> &hits) {
+    std::vector<std::pair<int, int>> ans;
+    for(int pos : hits) ans.push_back(c.locate(pos));
+    return ans;
+}
+
+int main() {
+    // A live hit must not be absorbed by a neighbouring or removed document.
+    {
+        collection c({L"xx", L"y", std::wstring(100, L'z')});
+        auto q = std::wstring(L"x") | std::wstring(L"y");
+        CHECK(located(c, c.search(q, 5)) == (std::vector<std::pair<int, int>>{{0, 0}, {0, 1}, {1, 0}}));
+        c.remove(0);
+        CHECK(located(c, c.search(q, 5)) == (std::vector<std::pair<int, int>>{{1, 0}}));
+    }
+    std::mt19937 rng(92);
+    for(int iter = 0; iter < 60; ++iter) {
+        int alphabet = 2 + iter % 3;
+        std::vector<std::wstring> docs(1 + rng() % 12);
+        for(auto &d : docs) d = random_text(rng, rng() % 30, alphabet);
+        collection c(docs, iter % 2 ? 0.25 : 1.0);
+        std::vector<string_data> alone;
+        for(auto &d : docs) alone.emplace_back(d);
+        std::vector<bool> dead(docs.size());
+        for(int step = 0; step < 20; ++step) {
+            if(rng() % 4 == 0) {
+                int id = rng() % docs.size();
+                CHECK(c.remove(id) == !dead[id]);
+                dead[id] = true;
+            }
+            std::vector<std::wstring> terms;
+            for(int k = 1 + rng() % 3; k > 0; --k) terms.push_back(random_text(rng, 1 + rng() % 2, alphabet));
+            int md = rng() % 4;
+            detail::grouped_data<detail::group_type::AND> all(terms);
+            detail::grouped_data<detail::group_type::OR> any(terms);
+
+            std::vector<std::pair<int, int>> single, either, both;
+            for(int id = 0; id < docs.size(); ++id) {
+                if(dead[id]) continue;
+                for(int p : brute_find(docs[id], terms[0])) single.push_back({id, p});
+                auto merged = brute_find(docs[id], terms[0]);
+                for(int k = 1; k < terms.size(); ++k) merged = brute_window_or(merged, brute_find(docs[id], terms[k]), md);
+                for(int p : merged) either.push_back({id, p});
+                for(int p : alone[id].search(all, md)) both.push_back({id, p});
+            }
+            CHECK(located(c, c.search(terms[0])) == single);
+            CHECK(located(c, c.search(any, md)) == either);
+            CHECK(located(c, c.search(all, md)) == both);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "compressed-posting.hpp"
+#include "check.hpp"
+#include <sstream>
+#include <fstream>
+#include <climits>
+#include <unistd.h>
+
+using namespace sa_ps;
+
+// Up to n distinct sorted values with gaps from 1 up to spread, so block bit
+// widths range from 0 (a lone hit at 0) to 31.
+std::vector<int> random_list(std::mt19937 &rng, int n, int spread) {
+    std::vector<int> ans;
+    long long x = rng() % (spread + 1LL);
+    for(int i = 0; i < n && x <= INT_MAX; ++i) {
+        ans.push_back(x);
+        x += 1 + rng() % spread;
+    }
+    return ans;
+}
+
+int main() {
+    std::mt19937 rng(78);
+    std::string path = "test-compressed-posting." + std::to_string(getpid()) + ".bin";
+    int sizes[] = {0, 1, 2, 127, 128, 129, 255, 256, 1000, 5000};
+    int spreads[] = {1, 3, 100, 70000, 1 << 24, INT_MAX};
+    for(int iter = 0; iter < 120; ++iter) {
+        auto a = random_list(rng, sizes[iter % 10], spreads[iter / 10 % 6]);
+        auto b = random_list(rng, sizes[rng() % 10], spreads[rng() % 6]);
+        compressed_posting pa(a), pb(b);
+        CHECK(pa.size() == a.size());
+        CHECK(pa.to_vector() == a);
+
+        std::vector<int> walked;
+        for(compressed_posting::cursor c(pa); !c.done(); c.next()) walked.push_back(c.value());
+        CHECK(walked == a);
+
+        // Seeking to increasing targets lands on the first hit >= target,
+        // whether the target is in the current block or several ahead.
+        compressed_posting::cursor c(pa);
+        long long target = -1;
+        while(true) {
+            target += rng() % 4 == 0 ? 0 : rng() % 3 ? rng() % 200 : rng() % (spreads[iter / 10 % 6] * 300LL + 1);
+            if(target > INT_MAX) break;
+            c.advance_to(target);
+            auto it = std::lower_bound(a.begin(), a.end(), target);
+            CHECK(c.done() == (it == a.end()));
+            if(c.done()) break;
+            CHECK(c.value() == *it);
+            target = *it;
+        }
+
+        std::vector<int> both;
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(both));
+        CHECK(intersect(pa, pb) == both);
+        CHECK(intersect(pa, pa) == a);
+
+        {
+            std::ofstream out(path, std::ios::binary);
+            pa.write(out);
+            pb.write(out);
+        }
+        std::ifstream in(path, std::ios::binary);
+        auto ra = compressed_posting::read(in), rb = compressed_posting::read(in);
+        CHECK(in);
+        CHECK(ra.to_vector() == a && rb.to_vector() == b);
+        CHECK(intersect(ra, rb) == both);
+    }
+    // Heavily overlapping lists: every block meets the other list.
+    std::vector<int> a, b;
+    for(int x = 0; x < 100000; ++x) {
+        if(rng() % 3) a.push_back(x);
+        if(rng() % 3) b.push_back(x);
+    }
+    std::vector<int> both;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(both));
+    CHECK(intersect(compressed_posting(a), compressed_posting(b)) == both);
+    std::remove(path.c_str());
+    return 0;
+}
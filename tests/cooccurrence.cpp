@@ -0,0 +1,52 @@
+#include "string-data.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+// Whether every list has a hit in [first, last].
+bool covers(const std::vector<std::vector<int>> &lists, int first, int last) {
+    for(auto &list : lists) {
+        auto it = std::lower_bound(list.begin(), list.end(), first);
+        if(it == list.end() || *it > last) return false;
+    }
+    return true;
+}
+
+// The minimal windows straight from the definition: for each end position,
+// the window [first, last] of length at most md holding a hit of every list
+// such that neither dropping its first nor its last position still does.
+std::vector<detail::match_window> brute_windows(const std::vector<std::vector<int>> &lists, int len, int md) {
+    std::vector<detail::match_window> ans;
+    for(int last = 0; last < len; ++last) {
+        for(int first = last; first >= 0 && last - first <= md; --first) {
+            if(covers(lists, first, last) && !covers(lists, first + 1, last) && !covers(lists, first, last - 1)) {
+                ans.push_back({first, last});
+            }
+        }
+    }
+    return ans;
+}
+
+int main() {
+    std::mt19937 rng(80);
+    for(int iter = 0; iter < 400; ++iter) {
+        int alphabet = 2 + iter % 4;
+        auto text = random_text(rng, 1 + rng() % 200, alphabet);
+        string_data data(text);
+        detail::grouped_data<detail::group_type::AND> query;
+        std::vector<std::vector<int>> lists;
+        int terms = 1 + rng() % 4;
+        for(int t = 0; t < terms; ++t) {
+            // Repeated and overlapping terms make hits share positions.
+            auto term = t > 0 && rng() % 4 == 0 ? query.strs[rng() % t] : random_text(rng, 1 + rng() % 3, alphabet);
+            query &= term;
+            lists.push_back(brute_find(text, term));
+        }
+        int md = iter % 10 == 0 ? 0 : rng() % 25;
+        auto expected = brute_windows(lists, text.size(), md);
+        CHECK(detail::cooccurrence(std::vector<std::span<const int>>(lists.begin(), lists.end()), md) == expected);
+        CHECK(data.windows(query, md) == expected);
+        CHECK(data.search(query, md) == detail::window_starts(expected));
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "string-data.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+const explain_node &child(const explain_node &node, int i) {
+    CHECK(i < node.children.size());
+    return node.children[i];
+}
+
+int main() {
+    std::mt19937 rng(93);
+    // 'a' is by far the most frequent character, and the only hot one.
+    std::wstring text;
+    for(int i = 0; i < 20000; ++i) text += rng() % 2 ? L'a' : (wchar_t)(L'a' + rng() % 16);
+    build_options options;
+    options.hot_chars = 1;
+    string_data data(text, options);
+
+    auto hot = data.explain_analyze(L"a");
+    CHECK(hot.op == "term" && hot.method == "hot_list" && hot.term == L"a");
+    CHECK(hot.interval == data.count(L'a') && hot.output_size == data.search(L"a").size());
+    CHECK(hot.children.empty());
+
+    auto single = data.explain_analyze(L"b");
+    CHECK(single.method == "char_table" && single.interval == data.count(L'b'));
+    CHECK(single.output_size == data.search(L"b").size());
+
+    std::wstring long_term = text.substr(100, 4);
+    auto term = data.explain_analyze(long_term);
+    CHECK(term.method == "bigram_table+binary_search" && term.probes > 0);
+    CHECK(term.interval == term.output_size && term.output_size == brute_find(text, long_term).size());
+    CHECK(data.explain_analyze(L"zz").method == "bigram_table" && data.explain_analyze(L"zz").output_size == 0);
+
+    auto all = std::wstring(L"a") & std::wstring(L"bc") & long_term;
+    auto merged = data.explain_analyze(all, 7);
+    CHECK(merged.op == "and" && merged.method == "max_distance=7" && merged.children.size() == 4);
+    CHECK(child(merged, 0).method == "hot_list" && child(merged, 1).method == "bigram_table");
+    auto &merge = child(merged, 3);
+    CHECK(merge.op == "merge" && merge.method == "cooccurrence");
+    CHECK(merge.input_sizes == (std::vector<long long>{hot.output_size, (long long)data.search(L"bc").size(), term.output_size}));
+    CHECK(merged.output_size == data.search(all, 7).size() && merge.output_size == merged.output_size);
+    CHECK(child(data.explain_analyze(all, 0), 3).method == "intersect");
+
+    auto few = std::wstring(L"ab") | std::wstring(L"ba");
+    auto unite = data.explain_analyze(few, 3);
+    CHECK(unite.op == "or" && child(unite, 2).method == "window_union");
+    CHECK(unite.output_size == data.search(few, 3).size());
+
+    // Sixteen single characters cover the text, so the OR scans it.
+    detail::grouped_data<detail::group_type::OR> wide;
+    for(int c = 0; c < 16; ++c) wide |= std::wstring(1, L'a' + c);
+    auto scan = data.explain_analyze(wide, 0);
+    CHECK(scan.children.size() == 2);
+    CHECK(child(scan, 0).op == "scan" && child(scan, 0).method == "aho_corasick");
+    CHECK(child(scan, 0).output_size == text.size());
+    CHECK(child(scan, 1).method == "bitmap_union" && child(scan, 1).input_sizes.size() == 16);
+    CHECK(scan.output_size == data.search(wide, 0).size());
+
+    // Terms are escaped: quotes, backslashes and control characters, with
+    // everything else as UTF-8, including characters above U+FFFF.
+    std::wstring odd = {L'q', L'"', L'\\', L'\n', (wchar_t)1, (wchar_t)0xE9, (wchar_t)0x4E2D, (wchar_t)0x1F600};
+    auto json = to_json(data.explain_analyze(odd));
+    CHECK(json.find(R"("term":"q\"\\\u000a\u0001)" "\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80\"") != std::string::npos);
+    CHECK(json.starts_with(R"({"op":"term","method":"bigram_table","term":)"));
+    CHECK(json.find("\"output_size\":0,") != std::string::npos);
+    auto tree = to_json(merged);
+    CHECK(tree.find(R"("children":[{"op":"term")") != std::string::npos);
+    CHECK(tree.find(R"("input_sizes":[)") != std::string::npos && tree.back() == '}');
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "hybrid-posting.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+// A sorted hit list over a few 65536-position containers, each empty, sparse,
+// dense, or right at the array/bitmap boundary (array_limit hits).
+std::vector<int> random_hits(std::mt19937 &rng) {
+    std::vector<int> hits;
+    for(int key = 0; key < 4; ++key) {
+        int count = 0;
+        switch(rng() % 6) {
+        case 0: break;
+        case 1: count = rng() % 50; break;
+        case 2: count = hybrid_posting::array_limit - 2 + rng() % 5; break;
+        case 3: count = 20000 + rng() % 20000; break;
+        case 4: count = 65536; break;
+        default: count = rng() % 3000; break;
+        }
+        std::vector<char> low(65536);
+        for(int k = 0; k < count;) {
+            int v = count == 65536 ? k : rng() % 65536;
+            if(low[v]) continue;
+            low[v] = 1;
+            ++k;
+        }
+        for(int v = 0; v < 65536; ++v) {
+            if(low[v]) hits.push_back(key << 16 | v);
+        }
+    }
+    return hits;
+}
+
+std::vector<int> brute_dilate(const std::vector<int> &hits, int md) {
+    if(hits.empty()) return {};
+    std::vector<int> cover(hits.back() + md + 2);
+    for(int x : hits) {
+        ++cover[std::max(0, x - md)];
+        --cover[x + md + 1];
+    }
+    std::vector<int> ans;
+    for(int p = 0, depth = 0; p < cover.size(); ++p) {
+        depth += cover[p];
+        if(depth > 0) ans.push_back(p);
+    }
+    return ans;
+}
+
+int main() {
+    std::mt19937 rng(77);
+    for(int iter = 0; iter < 40; ++iter) {
+        auto a = random_hits(rng), b = random_hits(rng);
+        hybrid_posting pa(a), pb(b);
+        CHECK(pa.to_vector() == a);
+        CHECK(pa.size() == a.size());
+        CHECK(pa.empty() == a.empty());
+        for(int q = 0; q < 200; ++q) {
+            int x = rng() % (5 << 16);
+            CHECK(pa.contains(x) == std::binary_search(a.begin(), a.end(), x));
+        }
+
+        std::vector<int> both, either;
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(both));
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(either));
+        CHECK((pa & pb).to_vector() == both);
+        CHECK((pa | pb).to_vector() == either);
+        CHECK((pa & pb).size() == both.size());
+        CHECK((pa | pb).size() == either.size());
+
+        int md = iter % 4 == 0 ? rng() % 4 : iter % 4 == 1 ? rng() % 200 : rng() % 70000 % 65536;
+        auto dilated = brute_dilate(b, md);
+        CHECK(pb.dilate(md).to_vector() == dilated);
+        std::vector<int> close;
+        std::set_intersection(a.begin(), a.end(), dilated.begin(), dilated.end(), std::back_inserter(close));
+        CHECK(near(pa, pb, md).to_vector() == close);
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "string-data.hpp"
+#include "check.hpp"
+#include <stdexcept>
+#include <atomic>
+#include <thread>
+
+using namespace sa_ps;
+
+bool loads(std::vector<char> bytes, bool verify) {
+    try {
+        detail::read_index(bytes.data(), bytes.size(), verify);
+        return true;
+    } catch(const std::runtime_error &) {
+        return false;
+    }
+}
+
+int main() {
+    std::mt19937 rng(89);
+    std::string path = "test-index-file." + std::to_string(getpid()) + ".idx";
+    for(int iter = 0; iter < 6; ++iter) {
+        auto text = random_text(rng, 1 + rng() % 3000, 2 + iter);
+        build_options options;
+        options.pack_sa = iter % 2;
+        string_data built(text, options);
+        built.save(path);
+        auto opened = string_data::open(path), verified = string_data::open(path, true);
+        CHECK(opened.validate().get());
+        for(int q = 0; q < 30; ++q) {
+            auto pattern = random_text(rng, 1 + rng() % 3, 2 + iter);
+            auto expected = brute_find(text, pattern);
+            CHECK(opened.search(pattern) == expected);
+            CHECK(verified.search(pattern) == expected);
+        }
+
+        // Saving over a path that is still mapped leaves the old mapping intact.
+        string_data other(random_text(rng, 50, 2));
+        other.save(path);
+        CHECK(opened.search(text.substr(0, 2)) == brute_find(text, text.substr(0, 2)));
+        CHECK(string_data::open(path).text() == other.text());
+
+        // Corrupt lookup tables fail to load even without hashing; a flipped
+        // text character is caught by the section hashes.
+        built.save(path);
+        auto m = detail::map_file(path);
+        std::vector<char> bytes(m->data(), m->data() + m->size());
+        auto &h = *(const detail::index_header *)bytes.data();
+        CHECK(loads(bytes, false) && loads(bytes, true));
+        auto corrupt = [&](int section, std::size_t at, auto value) {
+            auto copy = bytes;
+            std::memcpy(copy.data() + h.offset[section] + at, &value, sizeof(value));
+            return copy;
+        };
+        if(h.count[detail::section_hot] > 0) {
+            CHECK(!loads(corrupt(detail::section_hot, offsetof(detail::hot_list, size), 1 << 30), false));
+        }
+        if(h.count[detail::section_bigrams] > 0) {
+            CHECK(!loads(corrupt(detail::section_bigrams, offsetof(detail::bigram_interval, r), 1 << 30), false));
+        }
+        CHECK(!loads(corrupt(detail::section_c, 65536 * sizeof(int), -1), false));
+        CHECK(!loads(corrupt(detail::section_text, 0, (wchar_t)L'z'), true));
+    }
+    std::remove(path.c_str());
+
+    // Republishing while others attach: every attach finds a complete index,
+    // old or new, and earlier attachments keep theirs.
+    std::string name = "/sa-ps-test-index-file." + std::to_string(getpid());
+    string_data first(random_text(rng, 20000, 3)), second(random_text(rng, 30000, 4));
+    first.publish(name);
+    auto attached = string_data::attach(name);
+    std::atomic<bool> stop = false;
+    std::atomic<int> attaches = 0;
+    std::thread reader([&] {
+        while(!stop) {
+            auto data = string_data::attach(name);
+            CHECK(data.text() == first.text() || data.text() == second.text());
+            CHECK(data.validate().get());
+            ++attaches;
+        }
+    });
+    for(int i = 0; i < 40 || attaches < 10; ++i) {
+        (i % 2 ? first : second).publish(name);
+    }
+    stop = true;
+    reader.join();
+    CHECK(attached.text() == first.text());
+    CHECK(attached.search(L"ab") == brute_find(first.text(), L"ab"));
+    CHECK(shm_open((name + ".tmp." + std::to_string(getpid())).c_str(), O_RDONLY, 0) < 0);
+    string_data::unpublish(name);
+    return 0;
+}
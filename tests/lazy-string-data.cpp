@@ -0,0 +1,51 @@
+#include "lazy-string-data.hpp"
+#include "check.hpp"
+#include <stdexcept>
+
+using namespace sa_ps;
+
+int main() {
+    std::mt19937 rng(82);
+    // Queries before, during and after the switch from the scan to the
+    // suffix array give the same hits.
+    auto text = random_text(rng, 1 << 19, 4);
+    string_data reference(text);
+    std::vector<std::wstring> patterns;
+    for(int q = 0; q < 20; ++q) patterns.push_back(random_text(rng, 1 + rng() % 6, 4));
+    lazy_string_data lazy(text, 2);
+    int before = 0, after = 0;
+    while(after < 2 * patterns.size()) {
+        int q = (before + after) % patterns.size();
+        bool ready = lazy.ready();
+        CHECK(lazy.search(patterns[q]) == reference.search(patterns[q]));
+        auto all = patterns[q] & patterns[(q + 1) % patterns.size()];
+        auto any = patterns[q] | patterns[(q + 1) % patterns.size()];
+        CHECK(lazy.search(all, 8) == reference.search(all, 8));
+        CHECK(lazy.search(any, 8) == reference.search(any, 8));
+        ++(ready ? after : before);
+    }
+    lazy.wait();
+    CHECK(lazy.ready() && !lazy.error());
+
+    // A failed build leaves the scan serving; the failure is reported by
+    // wait() and error(). Text above U+FFFF makes the build throw.
+    std::wstring high = random_text(rng, 5000, 3);
+    for(int i = 0; i < 20; ++i) high[rng() % high.size()] = (wchar_t)0x1F600;
+    lazy_string_data failed(high, 2);
+    bool threw = false;
+    try {
+        failed.wait();
+    } catch(const std::invalid_argument &) {
+        threw = true;
+    }
+    CHECK(threw && !failed.ready() && failed.error());
+    for(auto &pattern : {std::wstring(1, (wchar_t)0x1F600), std::wstring(L"ab"), std::wstring{L'a', (wchar_t)0x1F600}}) {
+        CHECK(failed.search(pattern) == brute_find(high, pattern));
+    }
+    auto all = std::wstring(1, (wchar_t)0x1F600) & std::wstring(L"ab");
+    CHECK(failed.search(all, 4) == detail::window_starts(detail::cooccurrence({brute_find(high, all.strs[0]), brute_find(high, all.strs[1])}, 4)));
+
+    // Destroying it mid-build cancels the build quietly.
+    for(int i = 0; i < 5; ++i) lazy_string_data cancelled(text, 2);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "string-data.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+using detail::match_limits;
+using detail::match_status;
+
+// A limited result must report the unlimited result's size, and may only
+// drop a suffix of it, never reorder or invent hits.
+void check_limited(const detail::limited_hits &got, const std::vector<int> &full, const match_limits &limits, bool exact_total) {
+    std::size_t cap = limits.cap();
+    if(exact_total) CHECK(got.total == full.size());
+    switch(got.status) {
+    case match_status::complete:
+        CHECK(got.hits == full);
+        break;
+    case match_status::too_many:
+        CHECK(!limits.truncate);
+        CHECK(got.hits.empty());
+        CHECK(got.total > cap);
+        break;
+    case match_status::truncated:
+        CHECK(limits.truncate);
+        CHECK(got.hits.size() <= cap);
+        CHECK(got.hits.size() <= full.size());
+        CHECK(std::equal(got.hits.begin(), got.hits.end(), full.begin()));
+        break;
+    }
+}
+
+int main() {
+    std::mt19937 rng(99);
+    for(int iter = 0; iter < 40; ++iter) {
+        int alphabet = 2 + iter % 3;
+        auto text = random_text(rng, 1 + rng() % 400, alphabet);
+        build_options options;
+        options.pack_sa = iter % 2;
+        string_data data(text, options);
+        auto sa = detail::suffix_array(text);
+        for(int q = 0; q < 100; ++q) {
+            match_limits limits;
+            limits.max_hits = rng() % 3 ? rng() % (text.size() + 1) : SIZE_MAX;
+            if(rng() % 4 == 0) limits.max_bytes = rng() % (4 * text.size() + 4);
+            limits.truncate = rng() % 2;
+            int md = rng() % 4;
+            // Occasionally the whole text, which sa_match answers without the SA.
+            auto pattern = q % 10 ? random_text(rng, 1 + rng() % 3, alphabet) : text;
+            auto full = brute_find(text, pattern);
+            check_limited(data.search(pattern, limits), full, limits, true);
+            check_limited(detail::sa_match(text, sa, pattern, limits), full, limits, true);
+            if(!limits.truncate && full.size() > limits.cap()) CHECK(data.search(pattern, limits).status == match_status::too_many);
+            if(limits.truncate) CHECK(data.search(pattern, limits).hits.size() == std::min(full.size(), limits.cap()));
+
+            std::vector<std::wstring> terms;
+            for(int k = 1 + rng() % 3; k > 0; --k) terms.push_back(random_text(rng, 1 + rng() % 2, alphabet));
+            detail::grouped_data<detail::group_type::AND> all(terms);
+            detail::grouped_data<detail::group_type::OR> any(terms);
+            check_limited(data.search(all, md, limits), data.search(all, md), limits, false);
+            check_limited(data.search(any, md, limits), data.search(any, md), limits, false);
+            check_limited(detail::grouped_match(text, sa, all, md, limits), data.search(all, md), limits, false);
+        }
+    }
+    return 0;
+}
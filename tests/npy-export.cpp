@@ -0,0 +1,76 @@
+#include "string-data.hpp"
+#include "check.hpp"
+#include <fstream>
+#include <iterator>
+
+using namespace sa_ps;
+
+// The raw bytes of path.
+std::string slurp(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+// A version 1.0 '<i4' header for n values, data starting at byte 128.
+void check_header(const std::string &bytes, std::size_t n) {
+    CHECK(bytes.size() == npy_data_offset + 4 * n);
+    CHECK(bytes.compare(0, 8, "\x93NUMPY\x01\x00", 8) == 0);
+    CHECK((unsigned char)bytes[8] == npy_data_offset - 10 && bytes[9] == 0);
+    std::string dict = "{'descr': '<i4', 'fortran_order': False, 'shape': (" + std::to_string(n) + ",), }";
+    CHECK(bytes.compare(10, dict.size(), dict) == 0);
+    CHECK(bytes.find_first_not_of(' ', 10 + dict.size()) == npy_data_offset - 1);
+    CHECK(bytes[npy_data_offset - 1] == '\n');
+}
+
+void check_npy(const std::string &path, const std::vector<int> &expected) {
+    check_header(slurp(path), expected.size());
+    auto view = map_npy(path);
+    CHECK(std::vector<int>(view.values.begin(), view.values.end()) == expected);
+}
+
+int main() {
+    std::mt19937 rng(97);
+    std::string path = "test-npy-export." + std::to_string(getpid()) + ".npy";
+    for(int iter = 0; iter < 10; ++iter) {
+        auto text = random_text(rng, rng() % 2000, 2 + iter % 3);
+        build_options options;
+        options.pack_sa = iter % 2;
+        string_data data(text, options);
+        auto sa = brute_suffix_array(text);
+        data.export_sa(path);
+        check_npy(path, sa);
+
+        std::vector<int> lcp(text.size());
+        for(int i = 1; i < sa.size(); ++i) {
+            auto a = std::wstring_view(text).substr(sa[i - 1]), b = std::wstring_view(text).substr(sa[i]);
+            lcp[i] = std::mismatch(a.begin(), a.end(), b.begin(), b.end()).first - a.begin();
+        }
+        data.export_lcp(path);
+        check_npy(path, lcp);
+
+        auto hits = brute_find(text, random_text(rng, 1 + rng() % 2, 2 + iter % 3));
+        write_npy(path, hits);
+        check_npy(path, hits);
+
+        // Exporting over a file that is still mapped leaves the old mapping
+        // intact, and no temporary file behind.
+        auto old = map_npy(path);
+        write_npy(path, sa);
+        CHECK(std::vector<int>(old.values.begin(), old.values.end()) == hits);
+        check_npy(path, sa);
+        CHECK(!std::ifstream(path + ".tmp." + std::to_string(getpid())));
+    }
+    std::remove(path.c_str());
+
+    // Anything but a 1-D '<i4' array is refused.
+    std::ofstream(path, std::ios::binary) << std::string(200, 'x');
+    bool threw = false;
+    try {
+        map_npy(path);
+    } catch(const std::runtime_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+    std::remove(path.c_str());
+    return 0;
+}
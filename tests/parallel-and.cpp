@@ -0,0 +1,44 @@
+#include "string-data.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+int main() {
+    std::mt19937 rng(76);
+    // Any position range of cooccurrence_range is exactly the slice of the
+    // whole-list windows ending in it.
+    for(int iter = 0; iter < 300; ++iter) {
+        int len = 1 + rng() % 400, terms = 1 + rng() % 4, md = rng() % 3 ? rng() % 12 : rng() % 500;
+        std::vector<std::vector<int>> hits(terms);
+        for(auto &list : hits) {
+            for(int p = 0; p < len; ++p) {
+                if(rng() % 4 == 0) list.push_back(p);
+            }
+        }
+        std::vector<std::span<const int>> lists(hits.begin(), hits.end());
+        auto all = detail::cooccurrence(lists, md);
+        int lo = rng() % (len + 1), hi = lo + rng() % (len + 1 - lo);
+        std::vector<detail::match_window> expected;
+        for(auto &w : all) {
+            if(w.last >= lo && w.last < hi) expected.push_back(w);
+        }
+        CHECK(detail::cooccurrence_range(lists, md, lo, hi) == expected);
+    }
+    // Threaded AND search agrees with the serial one for any thread count.
+    for(int iter = 0; iter < 60; ++iter) {
+        int alphabet = 2 + iter % 4;
+        auto text = random_text(rng, 1 + rng() % 2000, alphabet);
+        string_data data(text);
+        detail::grouped_data<detail::group_type::AND> query;
+        int terms = 1 + rng() % 3;
+        for(int t = 0; t < terms; ++t) query &= random_text(rng, 1 + rng() % 2, alphabet);
+        int md = iter % 5 == 0 ? INT_MAX : rng() % 20;
+        auto windows = data.windows(query, md);
+        auto serial = data.search(query, md);
+        for(unsigned threads = 2; threads <= 9; ++threads) {
+            CHECK(data.windows(query, md, threads) == windows);
+            CHECK(data.search(query, md, threads) == serial);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "query-coalescer.hpp"
+#include "string-data.hpp"
+#include "check.hpp"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <stdexcept>
+
+using namespace sa_ps;
+
+// Counts executions and holds each one until released, so that concurrent
+// callers pile up on it; "fail" throws instead of returning hits.
+struct gated_index {
+    mutable std::atomic<int> calls = 0;
+    mutable std::mutex mutex;
+    mutable std::condition_variable cv;
+    bool open = false;
+
+    std::vector<int> search(const std::wstring &pattern) const {
+        int call = ++calls;
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [&] { return open; });
+        if(pattern == L"fail") throw std::runtime_error("failure " + std::to_string(call));
+        return {(int)pattern.size(), call};
+    }
+    template<detail::group_type Type>
+    std::vector<int> search(const detail::grouped_data<Type> &data, int md) const {
+        ++calls;
+        return {(int)data.strs.size(), md, Type};
+    }
+    void release() {
+        std::lock_guard lock(mutex);
+        open = true;
+        cv.notify_all();
+    }
+};
+
+// Starts `callers` identical searches, waits until they have all had time to
+// join the first one, then lets it finish; returns each caller's outcome.
+std::vector<std::pair<query_coalescer<gated_index>::result, std::string>> pile_up(const std::wstring &pattern, int callers) {
+    gated_index index;
+    query_coalescer<gated_index> coalescer(index);
+    std::vector<std::pair<query_coalescer<gated_index>::result, std::string>> outcomes(callers);
+    std::atomic<int> started = 0;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < callers; ++i) {
+        threads.emplace_back([&, i] {
+            ++started;
+            try {
+                outcomes[i].first = coalescer.search(pattern);
+            } catch(const std::runtime_error &e) {
+                outcomes[i].second = e.what();
+            }
+        });
+    }
+    while(started < callers || index.calls == 0) std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CHECK(coalescer.in_flight() == 1);
+    index.release();
+    for(auto &thread : threads) thread.join();
+    CHECK(index.calls == 1);
+    CHECK(coalescer.in_flight() == 0);
+    return outcomes;
+}
+
+int main() {
+    // One execution; every caller shares its result buffer.
+    auto outcomes = pile_up(L"abc", 8);
+    for(auto &[result, error] : outcomes) {
+        CHECK(result == outcomes[0].first && error.empty());
+    }
+    CHECK(*outcomes[0].first == (std::vector<int>{3, 1}));
+
+    // One execution; every caller gets the exception it threw.
+    for(auto &[result, error] : pile_up(L"fail", 8)) {
+        CHECK(!result && error == "failure 1");
+    }
+
+    // Completed queries are not cached, and distinct queries get distinct
+    // keys, even when their terms concatenate alike.
+    gated_index index;
+    index.release();
+    query_coalescer<gated_index> coalescer(index);
+    coalescer.search(L"x");
+    coalescer.search(L"x");
+    CHECK(index.calls == 2);
+    auto a = std::wstring(L"a"), bc = std::wstring(L"bc"), ab = std::wstring(L"ab"), c = std::wstring(L"c");
+    CHECK(*coalescer.search(a & bc, 3) == (std::vector<int>{2, 3, detail::AND}));
+    CHECK(*coalescer.search(a | bc, 3) == (std::vector<int>{2, 3, detail::OR}));
+    CHECK(*coalescer.search(ab & c, 4) == (std::vector<int>{2, 4, detail::AND}));
+
+    // Over a real index the results are search()'s.
+    std::mt19937 rng(87);
+    auto text = random_text(rng, 5000, 3);
+    string_data data(text);
+    query_coalescer<string_data> real(data);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for(int q = 0; q < 50; ++q) {
+                std::wstring pattern(1 + (q + t) % 3, L'a' + q % 3);
+                CHECK(*real.search(pattern) == brute_find(text, pattern));
+                CHECK(*real.search(pattern & std::wstring(L"b"), 4) == data.search(pattern & std::wstring(L"b"), 4));
+            }
+        });
+    }
+    for(auto &thread : threads) thread.join();
+    return 0;
+}
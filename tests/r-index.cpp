@@ -0,0 +1,30 @@
+#include "r-index.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+int main() {
+    std::mt19937 rng(96);
+    for(int iter = 0; iter < 60; ++iter) {
+        int alphabet = 1 + iter % 4;
+        auto text = random_text(rng, 1 + rng() % 200, alphabet);
+        // Repetitive texts, the case the r-index is for: a base repeated with edits.
+        if(iter % 2) {
+            auto base = text.substr(0, 1 + text.size() / 8);
+            text.clear();
+            for(int k = 0; k < 8; ++k) {
+                auto copy = base;
+                copy[rng() % copy.size()] = L'a' + rng() % alphabet;
+                text += copy;
+            }
+        }
+        r_index index(text);
+        for(int q = 0; q < 40; ++q) {
+            auto pattern = random_text(rng, 1 + rng() % 4, alphabet + 1);
+            auto expected = brute_find(text, pattern);
+            CHECK(index.count(pattern) == expected.size());
+            CHECK(index.search(pattern) == expected);
+        }
+    }
+    return 0;
+}
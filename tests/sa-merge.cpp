@@ -0,0 +1,39 @@
+#include "string-data.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+int main() {
+    std::mt19937 rng(91);
+    for(int iter = 0; iter < 300; ++iter) {
+        int alphabet = 1 + iter % 4;
+        auto a = random_text(rng, rng() % 60, alphabet), b = random_text(rng, rng() % 60, alphabet);
+        // In periodic texts every suffix of a repeats, so all of them go
+        // through the comparator's fix-up against b.
+        if(iter % 5 == 0) a = std::wstring(rng() % 40, L'a'), b = std::wstring(rng() % 40, L'a');
+        auto sa_a = detail::suffix_array(a), sa_b = detail::suffix_array(b);
+        CHECK(detail::merge_suffix_arrays(a, sa_a, b, sa_b) == brute_suffix_array(a + b));
+
+        string_data front(a), back(b), merged = string_data::merge(front, back), rebuilt(a + b);
+        for(int q = 0; q < 10; ++q) {
+            auto pattern = random_text(rng, 1 + rng() % 4, alphabet);
+            CHECK(merged.search(pattern) == brute_find(a + b, pattern));
+            CHECK(merged.count(pattern) == rebuilt.count(pattern));
+        }
+        CHECK(merged.validate().get());
+    }
+    // Texts ending in a repeat longer than the comparator's limit (4096) are
+    // sorted by the tagged sa_is fallback instead.
+    for(int iter = 0; iter < 6; ++iter) {
+        int alphabet = 1 + iter % 3;
+        std::wstring a = random_text(rng, rng() % 100, alphabet), b = random_text(rng, rng() % 100, alphabet);
+        std::wstring run = iter < 3 ? std::wstring(5000 + rng() % 1000, L'a') : L"";
+        for(int k = 0; iter >= 3 && k < 2600; ++k) run += L"ab";
+        a += run;
+        if(iter % 2) b = run + b;
+        auto sa_a = detail::suffix_array(a), sa_b = detail::suffix_array(b);
+        CHECK(detail::repeated_suffix(a, sa_a, 4096) == -1);
+        CHECK(detail::merge_suffix_arrays(a, sa_a, b, sa_b) == detail::suffix_array(a + b));
+    }
+    return 0;
+}
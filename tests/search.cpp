@@ -0,0 +1,36 @@
+#include "string-data.hpp"
+#include "check.hpp"
+
+using namespace sa_ps;
+
+int main() {
+    std::mt19937 rng(84);
+    for(int iter = 0; iter < 40; ++iter) {
+        int alphabet = 1 + iter % 5;
+        auto text = random_text(rng, 1 + rng() % 300, alphabet);
+        build_options options;
+        options.pack_sa = iter % 2;
+        options.hot_chars = iter % 3;
+        string_data data(text, options);
+        for(int q = 0; q < 50; ++q) {
+            auto pattern = random_text(rng, 1 + rng() % 4, alphabet + 1);
+            auto expected = brute_find(text, pattern);
+            CHECK(data.search(pattern) == expected);
+            CHECK(data.count(pattern) == expected.size());
+        }
+    }
+    // Query characters above U+FFFF cannot occur in the BMP-only text, and
+    // must not alias BMP characters in the C array or the bigram table.
+    std::wstring text = L"ab";
+    text += (wchar_t)0xF600;
+    text += L'b';
+    string_data data(text);
+    std::wstring high(1, (wchar_t)0x1F600), pair = {(wchar_t)0xF600, (wchar_t)0x10062};
+    CHECK(data.search(high).empty());
+    CHECK(data.count(high) == 0);
+    CHECK(data.count(high[0]) == 0);
+    CHECK(data.search(pair).empty());
+    CHECK(data.count(pair) == 0);
+    CHECK(data.search(high | std::wstring(L"b")) == (std::vector<int>{1, 3}));
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "set-kernels.hpp"
+#include "check.hpp"
+#include <climits>
+
+using namespace sa_ps::detail;
+
+// The pairing the window kernels implement, one element at a time.
+std::vector<int> brute_window(const std::vector<int> &a, const std::vector<int> &b, long long md, bool uni) {
+    std::vector<int> ans;
+    std::size_t j = 0, k = 0;
+    while(j < a.size() && k < b.size()) {
+        if(std::abs((long long)a[j] - b[k]) <= md) {
+            ans.push_back(std::min(a[j++], b[k++]));
+        } else if(a[j] < b[k]) {
+            if(uni) ans.push_back(a[j]);
+            ++j;
+        } else {
+            if(uni) ans.push_back(b[k]);
+            ++k;
+        }
+    }
+    if(uni) {
+        ans.insert(ans.end(), a.begin() + j, a.end());
+        ans.insert(ans.end(), b.begin() + k, b.end());
+    }
+    return ans;
+}
+
+std::vector<int> random_set(std::mt19937 &rng, int size, int universe) {
+    std::vector<int> v(size);
+    for(auto &x : v) x = rng() % universe;
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    return v;
+}
+
+int main() {
+    std::mt19937 rng(79);
+    for(int iter = 0; iter < 2000; ++iter) {
+        // Sizes far apart take the galloping path.
+        auto a = random_set(rng, rng() % 64, 256), b = random_set(rng, iter % 3 ? rng() % 64 : rng() % 1024, 256);
+        int md = rng() % 6;
+        CHECK(sorted_intersect(a, b) == brute_window(a, b, 0, false));
+        CHECK(scalar::sorted_intersect(a, b) == brute_window(a, b, 0, false));
+        CHECK(sorted_union(a, b) == brute_window(a, b, 0, true));
+        CHECK(window_and(a, b, md) == brute_window(a, b, md, false));
+        CHECK(window_or(a, b, md) == brute_window(a, b, md, true));
+    }
+    // Positions and distances near INT_MAX must not overflow the pair test.
+    std::vector<int> a = {5, INT_MAX - 3}, b = {INT_MAX - 1};
+    for(int md : {INT_MAX, INT_MAX - 5, INT_MAX - 10, 1}) {
+        CHECK(window_and(a, b, md) == brute_window(a, b, md, false));
+        CHECK(window_or(a, b, md) == brute_window(a, b, md, true));
+        CHECK(window_and(b, a, md) == brute_window(b, a, md, false));
+        CHECK(window_or(b, a, md) == brute_window(b, a, md, true));
+    }
+    return 0;
+}